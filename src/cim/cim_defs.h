@@ -37,30 +37,69 @@
 
 #ifndef CIMARRON_EXCLUDE_REGISTER_ACCESS_MACROS
 
+#if CIMARRON_GP_EMULATION
+
+#define READ_GP32(offset) gp_emu_read32(offset)
+
+#else
+
 #define READ_GP32(offset) \
     (*(volatile unsigned long *)(cim_gp_ptr + (offset)))
 
+#endif
+
 #define READ_REG32(offset) \
     (*(volatile unsigned long *)(cim_vg_ptr + (offset)))
 
+#if CIMARRON_GP_EMULATION
+
+#define READ_FB32(offset) \
+    (*(volatile uint32_t *)(cim_fb_ptr + (offset)))
+
+#else
+
 #define READ_FB32(offset) \
     (*(volatile unsigned long *)(cim_fb_ptr + (offset)))
 
+#endif
+
+#if CIMARRON_GP_EMULATION
+
+#define WRITE_GP32(offset, value) gp_emu_write32((offset), (value))
+
+#else
+
 #define WRITE_GP32(offset, value) \
 	(*(volatile unsigned long *)(cim_gp_ptr + (offset))) = (value)
 
+#endif
+
 #define WRITE_REG32(offset, value) \
 	(*(volatile unsigned long *)(cim_vg_ptr + (offset))) = (value)
 
+#if CIMARRON_GP_EMULATION
+
+/* THE EMULATOR MAY RUN ON A HOST WITH 64-BIT LONGS */
+
 #define WRITE_COMMAND32(offset, value) \
-	(*(unsigned long *)(cim_cmd_ptr + (offset))) = (value)
+	(*(uint32_t *)(cim_cmd_ptr + (offset))) = (value)
 
-#define WRITE_COMMAND8(offset, value) \
-	(*(unsigned char *)(cim_cmd_ptr + (offset))) = (value)
+#define WRITE_FB32(offset, value) \
+	(*(uint32_t *)(cim_fb_ptr + (offset))) = (value)
+
+#else
+
+#define WRITE_COMMAND32(offset, value) \
+	(*(unsigned long *)(cim_cmd_ptr + (offset))) = (value)
 
 #define WRITE_FB32(offset, value) \
 	(*(unsigned long *)(cim_fb_ptr + (offset))) = (value)
 
+#endif
+
+#define WRITE_COMMAND8(offset, value) \
+	(*(unsigned char *)(cim_cmd_ptr + (offset))) = (value)
+
 #define READ_VID32(offset) \
     (*(volatile unsigned long *)(cim_vid_ptr + (offset)))
 
@@ -85,13 +124,18 @@
 /*            GP POLLING MACROS            */
 /*-----------------------------------------*/
 
+/* Any commands held back by batched submission are released before */
+/* polling, as the GP cannot advance past the published write pointer. */
+
 #define GP3_WAIT_WRAP(variable) \
 	while(((variable = READ_GP32 (GP3_CMD_READ)) > gp3_cmd_current) || \
-           (variable <= (gp3_cmd_top + GP3_BLT_COMMAND_SIZE + GP3_BLT_COMMAND_SIZE + 96)))
+           (variable <= (gp3_cmd_top + GP3_BLT_COMMAND_SIZE + GP3_BLT_COMMAND_SIZE + 96))) \
+        gp_flush_command_buffer ()
 
 #define GP3_WAIT_PRIMITIVE(variable) \
 	while (((variable = READ_GP32 (GP3_CMD_READ)) > gp3_cmd_current) && \
-            (variable <= (gp3_cmd_next + 96)))
+            (variable <= (gp3_cmd_next + 96))) \
+        gp_flush_command_buffer ()
 
 #define GP3_WAIT_BUSY \
 	while(READ_GP32 (GP3_BLT_STATUS) & GP3_BS_BLT_BUSY)
@@ -99,6 +143,29 @@
 #define GP3_WAIT_PENDING \
 	while(READ_GP32 (GP3_BLT_STATUS) & GP3_BS_BLT_PENDING)
 
+/*-----------------------------------------*/
+/*        GP COMMAND SUBMISSION MACRO      */
+/*-----------------------------------------*/
+
+#define GP3_SUBMIT_BATCHED(size) \
+{ \
+    gp3_batch_size += (size); \
+    if (gp3_batch_size >= gp3_batch_limit) { \
+        gp3_batch_size = 0; \
+        WRITE_GP32 (GP3_CMD_WRITE, gp3_cmd_current); \
+    } \
+}
+
+/* The write pointer only moves backwards once a wrapped command has been */
+/* written, which starts a new lap of the buffer for command markers.     */
+
+#define GP3_ADVANCE_CURRENT \
+{ \
+    if (gp3_cmd_next < gp3_cmd_current) \
+        gp3_cmd_laps++; \
+    gp3_cmd_current = gp3_cmd_next; \
+}
+
 /*-----------------------------------------------------------------*/
 /* MSR MACROS                                                      */
 /* These macros facilitate interaction with the model specific     */
@@ -109,7 +176,22 @@
 
 #ifdef CIMARRON_INCLUDE_MSR_MACROS
 
-#if CIMARRON_MSR_DIRECT_ASM
+#if CIMARRON_GP_EMULATION
+
+/*-----------------------------------------------------------------
+ * There are no MSRs to access when the GP is emulated.  Reads
+ * return zero and writes are dropped.
+ *-----------------------------------------------------------------*/
+
+#define MSR_READ(msr_reg, device_add, data64_ptr)                  \
+{                                                                  \
+	((Q_WORD *)(data64_ptr))->high = 0;                        \
+	((Q_WORD *)(data64_ptr))->low = 0;                         \
+}
+
+#define MSR_WRITE(msr_reg, device_add, data64_ptr)
+
+#elif CIMARRON_MSR_DIRECT_ASM
 
 /*-----------------------------------------------------------------
  * MSR_READ
@@ -323,7 +405,48 @@
 
 #ifdef CIMARRON_INCLUDE_STRING_MACROS
 
-#if CIMARRON_OPTIMIZE_ASSEMBLY
+#if CIMARRON_GP_EMULATION
+
+/*-----------------------------------------------------------------
+ * The emulator copies DWORDs with 32-bit C types, as a long or a
+ * string instruction may be wider than a DWORD on the host.
+ *-----------------------------------------------------------------*/
+
+#define WRITE_COMMAND_STRING32(offset, dataptr, dataoffset, dword_count) \
+{                                                                        \
+	unsigned long i;                                                     \
+	unsigned char *tempdata = (unsigned char *)(dataptr) + (dataoffset); \
+	for (i = 0; i < (dword_count); i++)                                  \
+		WRITE_COMMAND32 ((offset) + (i << 2),                            \
+						 *((uint32_t *)(tempdata + (i << 2))));          \
+}
+
+#define WRITE_FB_STRING32(offset, dataptr, dword_count)                  \
+{                                                                        \
+	unsigned long i;                                                     \
+	unsigned char *tempdata = (unsigned char *)(dataptr);                \
+	for (i = 0; i < (dword_count); i++)                                  \
+		WRITE_FB32 ((offset) + (i << 2),                                 \
+					*((uint32_t *)(tempdata + (i << 2))));               \
+}
+
+#define WRITE_FB_CONSTANT(offset, value, dword_count)                    \
+{                                                                        \
+	unsigned long i;                                                     \
+	for (i = 0; i < (dword_count); i++)                                  \
+		WRITE_FB32 ((offset) + (i << 2), value);                         \
+}
+
+#define WRITE_HOST_SOURCE_STRING32(dataptr, dataoffset, dword_count)     \
+{                                                                        \
+	unsigned long i;                                                     \
+	unsigned char *tempdata = (unsigned char *)(dataptr) + (dataoffset); \
+	for (i = 0; i < (dword_count); i++)                                  \
+		WRITE_GP32 ((i << 2) + GP3_HST_SRC_RANGE,                        \
+					*((uint32_t *)(tempdata + (i << 2))));               \
+}
+
+#elif CIMARRON_OPTIMIZE_ASSEMBLY
 
 /*-----------------------------------------------------------------
  * WRITE_COMMAND_STRING32   
@@ -60,6 +60,9 @@ CIMARRON_STATIC unsigned long gp3_vector_pattern_color;
 CIMARRON_STATIC unsigned long gp3_scratch_base;
 CIMARRON_STATIC unsigned long gp3_base_register;
 CIMARRON_STATIC unsigned long gp3_vec_pat;
+CIMARRON_STATIC unsigned long gp3_batch_limit = 0;
+CIMARRON_STATIC unsigned long gp3_batch_size = 0;
+CIMARRON_STATIC unsigned long gp3_cmd_laps = 0;
 
 /*---------------------------------------------------------------------------
  * gp_set_limit_on_buffer_lead
@@ -78,6 +81,44 @@ gp_set_limit_on_buffer_lead(unsigned long lead)
     gp3_buffer_lead = lead;
 }
 
+/*---------------------------------------------------------------------------
+ * gp_set_command_batching
+ *
+ * This routine is used to enable batched submission of simple BLTs.  When
+ * 'limit' is non-zero, pattern fills, screen to screen BLTs and calls to
+ * gp_write_parameters will write their commands into the command buffer
+ * without updating the GP write pointer.  The write pointer is updated once
+ * 'limit' bytes of commands are outstanding, whenever Cimarron must wait
+ * for the GP, when a command that is not batched is submitted, or when
+ * gp_flush_command_buffer is called.  A limit of zero restores the default
+ * behavior of submitting every command immediately.
+ *-------------------------------------------------------------------------*/
+
+void
+gp_set_command_batching(unsigned long limit)
+{
+    gp_flush_command_buffer();
+
+    gp3_batch_limit = limit;
+}
+
+/*---------------------------------------------------------------------------
+ * gp_flush_command_buffer
+ *
+ * This routine updates the GP write pointer to include all commands that
+ * have been deferred by batched submission.  It does nothing if no commands
+ * are outstanding.
+ *-------------------------------------------------------------------------*/
+
+void
+gp_flush_command_buffer(void)
+{
+    if (gp3_batch_size) {
+        gp3_batch_size = 0;
+        WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_current);
+    }
+}
+
 /*---------------------------------------------------------------------------
  * gp_set_command_buffer_base
  *
@@ -121,6 +162,7 @@ gp_set_command_buffer_base(unsigned long address, unsigned long start,
 
     gp3_cmd_current = gp3_cmd_top = start;
     gp3_cmd_bottom = stop;
+    gp3_batch_size = 0;
 }
 
 /*---------------------------------------------------------------------------
@@ -272,6 +314,7 @@ gp_declare_blt(unsigned long flags)
     }
 
     if (flags & CIMGP_BLTFLAGS_LIMITBUFFER) {
+        gp_flush_command_buffer();
         while (1) {
             temp = READ_GP32(GP3_CMD_READ);
             if (((gp3_cmd_current >= temp)
@@ -343,6 +386,7 @@ gp_declare_vector(unsigned long flags)
     }
 
     if (flags & CIMGP_BLTFLAGS_LIMITBUFFER) {
+        gp_flush_command_buffer();
         while (1) {
             temp = READ_GP32(GP3_CMD_READ);
             if (((gp3_cmd_current >= temp)
@@ -384,11 +428,11 @@ gp_write_parameters(void)
 
     /* INCREMENT THE CURRENT WRITE POINTER */
 
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 
     /* UPDATE THE GP WRITE POINTER */
 
-    WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_current);
+    GP3_SUBMIT_BATCHED(GP3_BLT_COMMAND_SIZE);
 }
 
 /*---------------------------------------------------------------------------
@@ -675,7 +719,7 @@ gp_set_color_pattern(unsigned long *pattern, int format, int x, int y)
     /* START OPERATION */
 
     WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 
     /* SAVE PATTERN ORIGIN */
 
@@ -819,7 +863,7 @@ gp_program_lut(unsigned long *colors, int full_lut)
     /* START OPERATION */
 
     WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 }
 
 /*---------------------------------------------------------------------------
@@ -899,7 +943,7 @@ gp_set_vector_pattern(unsigned long pattern, unsigned long color, int length)
     /* START OPERATION */
 
     WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 }
 
 /*---------------------------------------------------------------------------
@@ -1029,8 +1073,8 @@ gp_pattern_fill(unsigned long dstoffset, unsigned long width,
 
     WRITE_COMMAND32(GP3_BLT_CMD_HEADER, gp3_cmd_header);
     WRITE_COMMAND32(GP3_BLT_MODE, gp3_blt_mode);
-    WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
+    GP3_SUBMIT_BATCHED(GP3_BLT_COMMAND_SIZE);
 }
 
 /*---------------------------------------------------------------------------
@@ -1160,8 +1204,8 @@ gp_screen_to_screen_blt(unsigned long dstoffset, unsigned long srcoffset,
 
     WRITE_COMMAND32(GP3_BLT_CMD_HEADER, gp3_cmd_header);
     WRITE_COMMAND32(GP3_BLT_MODE, blt_mode);
-    WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
+    GP3_SUBMIT_BATCHED(GP3_BLT_COMMAND_SIZE);
 }
 
 /*---------------------------------------------------------------------------
@@ -1224,7 +1268,7 @@ gp_screen_to_screen_convert(unsigned long dstoffset, unsigned long srcoffset,
     WRITE_COMMAND32(GP3_BLT_CMD_HEADER, gp3_cmd_header);
     WRITE_COMMAND32(GP3_BLT_MODE, gp3_blt_mode);
     WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 }
 
 /*---------------------------------------------------------------------------
@@ -1292,7 +1336,7 @@ gp_color_bitmap_to_screen_blt(unsigned long dstoffset, unsigned long srcx,
 
     WRITE_COMMAND32(GP3_BLT_CMD_HEADER, gp3_cmd_header);
     WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 
     /* CALCULATE THE SIZE OF ONE LINE */
 
@@ -1344,7 +1388,7 @@ gp_color_bitmap_to_screen_blt(unsigned long dstoffset, unsigned long srcx,
         }
 
         WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-        gp3_cmd_current = gp3_cmd_next;
+        GP3_ADVANCE_CURRENT;
     }
     else {
         /*
@@ -1397,7 +1441,7 @@ gp_color_bitmap_to_screen_blt(unsigned long dstoffset, unsigned long srcx,
 
             srcoffset += pitch;
             WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-            gp3_cmd_current = gp3_cmd_next;
+            GP3_ADVANCE_CURRENT;
         }
     }
 }
@@ -1503,7 +1547,7 @@ gp_color_convert_blt(unsigned long dstoffset, unsigned long srcx,
 
     WRITE_COMMAND32(GP3_BLT_CMD_HEADER, gp3_cmd_header);
     WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 
     if (((total_dwords << 2) * height) <= GP3_BLT_1PASS_SIZE &&
         (gp3_cmd_bottom - gp3_cmd_current) > (GP3_BLT_1PASS_SIZE + 72)) {
@@ -1544,7 +1588,7 @@ gp_color_convert_blt(unsigned long dstoffset, unsigned long srcx,
         }
 
         WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-        gp3_cmd_current = gp3_cmd_next;
+        GP3_ADVANCE_CURRENT;
     }
     else {
         /* WRITE DATA LINE BY LINE
@@ -1597,7 +1641,7 @@ gp_color_convert_blt(unsigned long dstoffset, unsigned long srcx,
 
             srcoffset += pitch;
             WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-            gp3_cmd_current = gp3_cmd_next;
+            GP3_ADVANCE_CURRENT;
         }
     }
 }
@@ -1704,7 +1748,7 @@ gp_custom_convert_blt(unsigned long dstoffset, unsigned long srcx,
 
     WRITE_COMMAND32(GP3_BLT_CMD_HEADER, gp3_cmd_header);
     WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 
     if (((total_dwords << 2) * height) <= GP3_BLT_1PASS_SIZE &&
         (gp3_cmd_bottom - gp3_cmd_current) > (GP3_BLT_1PASS_SIZE + 72)) {
@@ -1747,7 +1791,7 @@ gp_custom_convert_blt(unsigned long dstoffset, unsigned long srcx,
         }
 
         WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-        gp3_cmd_current = gp3_cmd_next;
+        GP3_ADVANCE_CURRENT;
     }
     else {
         /* WRITE DATA LINE BY LINE
@@ -1802,7 +1846,7 @@ gp_custom_convert_blt(unsigned long dstoffset, unsigned long srcx,
 
             srcoffset += pitch;
             WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-            gp3_cmd_current = gp3_cmd_next;
+            GP3_ADVANCE_CURRENT;
         }
     }
 }
@@ -1895,7 +1939,7 @@ gp_rotate_blt(unsigned long dstoffset, unsigned long srcoffset,
     WRITE_COMMAND32(GP3_BLT_CMD_HEADER, gp3_cmd_header);
     WRITE_COMMAND32(GP3_BLT_MODE, gp3_blt_mode);
     WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 }
 
 /*---------------------------------------------------------------------------
@@ -1977,7 +2021,7 @@ gp_mono_bitmap_to_screen_blt(unsigned long dstoffset, unsigned long srcx,
 
     WRITE_COMMAND32(GP3_BLT_CMD_HEADER, gp3_cmd_header);
     WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 
     /* CALCULATE THE SIZE OF ONE LINE */
 
@@ -2032,7 +2076,7 @@ gp_mono_bitmap_to_screen_blt(unsigned long dstoffset, unsigned long srcx,
         }
 
         WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-        gp3_cmd_current = gp3_cmd_next;
+        GP3_ADVANCE_CURRENT;
     }
     else {
         /* WRITE DATA LINE BY LINE
@@ -2086,7 +2130,7 @@ gp_mono_bitmap_to_screen_blt(unsigned long dstoffset, unsigned long srcx,
 
             srcoffset += stride;
             WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-            gp3_cmd_current = gp3_cmd_next;
+            GP3_ADVANCE_CURRENT;
         }
     }
 }
@@ -2153,7 +2197,7 @@ gp_text_blt(unsigned long dstoffset, unsigned long width,
 
     WRITE_COMMAND32(GP3_BLT_CMD_HEADER, gp3_cmd_header);
     WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 
     /* CALCULATE THE TOTAL NUMBER OF BYTES */
 
@@ -2211,7 +2255,7 @@ gp_text_blt(unsigned long dstoffset, unsigned long width,
                               srcoffset + (dword_count << 2), byte_count);
 
         WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-        gp3_cmd_current = gp3_cmd_next;
+        GP3_ADVANCE_CURRENT;
 
         /* UPDATE THE SOURCE OFFSET */
         /* We add a constant value because the code will loop only if the */
@@ -2332,7 +2376,7 @@ gp_mono_expand_blt(unsigned long dstoffset, unsigned long srcoffset,
             WRITE_COMMAND32(GP3_BLT_CMD_HEADER, gp3_cmd_header);
             WRITE_COMMAND32(GP3_BLT_MODE, blt_mode);
             WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-            gp3_cmd_current = gp3_cmd_next;
+            GP3_ADVANCE_CURRENT;
             gp_wait_until_idle();
 
             gp_declare_blt(gp3_blt_flags);
@@ -2349,7 +2393,7 @@ gp_mono_expand_blt(unsigned long dstoffset, unsigned long srcoffset,
             WRITE_COMMAND32(GP3_BLT_CMD_HEADER, gp3_cmd_header);
             WRITE_COMMAND32(GP3_BLT_MODE, blt_mode);
             WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-            gp3_cmd_current = gp3_cmd_next;
+            GP3_ADVANCE_CURRENT;
             gp_wait_until_idle();
 
             if (--height) {
@@ -2381,7 +2425,7 @@ gp_mono_expand_blt(unsigned long dstoffset, unsigned long srcoffset,
                 WRITE_COMMAND32(GP3_BLT_CMD_HEADER, gp3_cmd_header);
                 WRITE_COMMAND32(GP3_BLT_MODE, blt_mode);
                 WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-                gp3_cmd_current = gp3_cmd_next;
+                GP3_ADVANCE_CURRENT;
                 gp_wait_until_idle();
 
                 height -= tempheight;
@@ -2416,7 +2460,7 @@ gp_mono_expand_blt(unsigned long dstoffset, unsigned long srcoffset,
     WRITE_COMMAND32(GP3_BLT_CMD_HEADER, gp3_cmd_header);
     WRITE_COMMAND32(GP3_BLT_MODE, blt_mode);
     WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 }
 
 /*---------------------------------------------------------------------------
@@ -2525,7 +2569,7 @@ gp_antialiased_text(unsigned long dstoffset, unsigned long srcx,
 
     WRITE_COMMAND32(GP3_BLT_CMD_HEADER, gp3_cmd_header);
     WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 
     /* WRITE DATA LINE BY LINE
      * Each line will be created as a separate command buffer entry to allow
@@ -2572,7 +2616,7 @@ gp_antialiased_text(unsigned long dstoffset, unsigned long srcx,
         }
 
         WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-        gp3_cmd_current = gp3_cmd_next;
+        GP3_ADVANCE_CURRENT;
     }
     else {
         while (height--) {
@@ -2620,7 +2664,7 @@ gp_antialiased_text(unsigned long dstoffset, unsigned long srcx,
 
             srcoffset += stride;
             WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-            gp3_cmd_current = gp3_cmd_next;
+            GP3_ADVANCE_CURRENT;
         }
     }
 }
@@ -2686,7 +2730,7 @@ gp_masked_blt(unsigned long dstoffset, unsigned long width,
     /* START THE BLT */
 
     WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 
     for (i = 0; i < height; i++) {
         /* UPDATE THE COMMAND POINTER
@@ -2732,7 +2776,7 @@ gp_masked_blt(unsigned long dstoffset, unsigned long width,
 
         srcoffset += mono_pitch;
         WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-        gp3_cmd_current = gp3_cmd_next;
+        GP3_ADVANCE_CURRENT;
     }
 
     /* SECOND BLT */
@@ -2814,7 +2858,7 @@ gp_masked_blt(unsigned long dstoffset, unsigned long width,
 
     WRITE_COMMAND32(GP3_BLT_CMD_HEADER, gp3_cmd_header);
     WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 
     /* WRITE DATA LINE BY LINE */
 
@@ -2858,7 +2902,7 @@ gp_masked_blt(unsigned long dstoffset, unsigned long width,
 
         srcoffset += color_pitch;
         WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-        gp3_cmd_current = gp3_cmd_next;
+        GP3_ADVANCE_CURRENT;
     }
 }
 
@@ -2924,7 +2968,7 @@ gp_screen_to_screen_masked(unsigned long dstoffset, unsigned long srcoffset,
     /* START THE BLT */
 
     WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 
     for (i = 0; i < height; i++) {
         /* UPDATE THE COMMAND POINTER
@@ -2969,7 +3013,7 @@ gp_screen_to_screen_masked(unsigned long dstoffset, unsigned long srcoffset,
 
         srcoff += mono_pitch;
         WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-        gp3_cmd_current = gp3_cmd_next;
+        GP3_ADVANCE_CURRENT;
     }
 
     /* SECOND BLT */
@@ -3021,7 +3065,7 @@ gp_screen_to_screen_masked(unsigned long dstoffset, unsigned long srcoffset,
 
     WRITE_COMMAND32(GP3_BLT_CMD_HEADER, gp3_cmd_header);
     WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 }
 
 /*---------------------------------------------------------------------------
@@ -3138,7 +3182,7 @@ gp_bresenham_line(unsigned long dstoffset, unsigned short length,
     WRITE_COMMAND32(GP3_VECTOR_MODE, (gp3_vec_mode | flags));
     WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
 
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 
     /* ADD A SECOND VECTOR TO CLEAR THE BYTE ENABLES            */
     /* We set a transparent pattern to clear the byte enables.  */
@@ -3326,7 +3370,7 @@ gp_line_from_endpoints(unsigned long dstoffset, unsigned long x0,
     WRITE_COMMAND32(GP3_VEC_CMD_HEADER, gp3_cmd_header);
     WRITE_COMMAND32(GP3_VECTOR_MODE, (gp3_vec_mode | flags));
     WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 
     /* ADD A SECOND VECTOR TO CLEAR THE BYTE ENABLES            */
     /* We set a transparent pattern to clear the byte enables.  */
@@ -3371,6 +3415,8 @@ gp_wait_until_idle(void)
 {
     unsigned long temp;
 
+    gp_flush_command_buffer();
+
     while (((temp = READ_GP32(GP3_BLT_STATUS)) & GP3_BS_BLT_BUSY) ||
            !(temp & GP3_BS_CB_EMPTY)) {
         ;
@@ -3386,6 +3432,8 @@ gp_test_blt_busy(void)
 {
     unsigned long temp;
 
+    gp_flush_command_buffer();
+
     if (((temp = READ_GP32(GP3_BLT_STATUS)) & GP3_BS_BLT_BUSY) ||
         !(temp & GP3_BS_CB_EMPTY))
         return 1;
@@ -3400,6 +3448,8 @@ gp_test_blt_busy(void)
 int
 gp_test_blt_pending(void)
 {
+    gp_flush_command_buffer();
+
     if ((READ_GP32(GP3_BLT_STATUS)) & GP3_BS_BLT_PENDING)
         return 1;
 
@@ -3413,9 +3463,100 @@ gp_test_blt_pending(void)
 void
 gp_wait_blt_pending(void)
 {
+    gp_flush_command_buffer();
+
     while ((READ_GP32(GP3_BLT_STATUS)) & GP3_BS_BLT_PENDING);
 }
 
+/*---------------------------------------------------------------------------
+ * gp_get_command_marker
+ *
+ * This routine returns a marker for all commands written to the command
+ * buffer so far.  The marker holds the current write offset in the low 24
+ * bits and the number of times the command buffer has wrapped in the upper
+ * 8 bits.  It can later be passed to gp_test_command_marker or
+ * gp_wait_command_marker to determine whether those commands have retired.
+ *-------------------------------------------------------------------------*/
+
+unsigned long
+gp_get_command_marker(void)
+{
+    return ((gp3_cmd_laps & 0xFF) << 24) | (gp3_cmd_current & 0xFFFFFF);
+}
+
+/*---------------------------------------------------------------------------
+ * gp_test_command_marker
+ *
+ * This routine returns 1 if all commands preceding a marker have completed.
+ * The commands have been fetched once the GP read pointer has passed the
+ * marker position in the same lap of the command buffer, or once the GP is
+ * in a later lap.  A fetched primitive may still be active or pending, so
+ * the commands are only considered complete when the GP is no longer busy
+ * or when it has fetched more than GP3_MAX_COMMAND_SIZE bytes beyond the
+ * marker, which it cannot do while an earlier primitive is outstanding.
+ * A marker is always complete when the GP is idle, which also covers
+ * markers that are older than the 8-bit lap count.
+ *-------------------------------------------------------------------------*/
+
+int
+gp_test_command_marker(unsigned long marker)
+{
+    unsigned long status, read, laps, offset;
+    unsigned long distance;
+
+    gp_flush_command_buffer();
+
+    status = READ_GP32(GP3_BLT_STATUS);
+    if (!(status & GP3_BS_BLT_BUSY) && (status & GP3_BS_CB_EMPTY))
+        return 1;
+
+    /* DETERMINE THE LAP THE HARDWARE IS IN */
+    /* The GP can never lead software, so a read pointer beyond the */
+    /* current write offset must still be in the previous lap.      */
+
+    read = READ_GP32(GP3_CMD_READ);
+    laps = gp3_cmd_laps;
+    if (read > gp3_cmd_current)
+        laps--;
+
+    laps = (laps - (marker >> 24)) & 0xFF;
+    offset = marker & 0xFFFFFF;
+
+    if (laps == 0) {
+        if (read < offset)
+            return 0;
+        distance = read - offset;
+    }
+    else if (laps == 1) {
+        /* THE DISTANCE BEFORE THE WRAP IS NOT KNOWN */
+        /* Counting from the top of the buffer underestimates it. */
+
+        distance = read - gp3_cmd_top;
+    }
+    else if (laps < 0x80)
+        return 1;
+    else
+        return 0;
+
+    if (distance > GP3_MAX_COMMAND_SIZE || !(status & GP3_BS_BLT_BUSY))
+        return 1;
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------
+ * gp_wait_command_marker
+ *
+ * This routine stalls execution until all commands preceding a marker
+ * have completed.
+ *-------------------------------------------------------------------------*/
+
+void
+gp_wait_command_marker(unsigned long marker)
+{
+    while (!gp_test_command_marker(marker));
+}
+
 /*---------------------------------------------------------------------------
  * gp_save_state
  *
@@ -3542,5 +3683,5 @@ gp_blend_mask_blt(unsigned long dstoffset, unsigned long srcx,
 
     WRITE_COMMAND32(GP3_BLT_CMD_HEADER, gp3_cmd_header);
     WRITE_GP32(GP3_CMD_WRITE, gp3_cmd_next);
-    gp3_cmd_current = gp3_cmd_next;
+    GP3_ADVANCE_CURRENT;
 }
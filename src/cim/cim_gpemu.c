@@ -0,0 +1,1208 @@
+/*
+ * Copyright (c) 2006 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Neither the name of the Advanced Micro Devices, Inc. nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ */
+
+ /*
+  * Cimarron software graphics processor.  These routines decode the GP3
+  * command buffer and execute BLTs, vectors, LUT loads and host data loads
+  * on the CPU.  The register file, frame buffer and command buffer all live
+  * in system memory, which allows the cim_gp.c routines (and everything
+  * built on top of them) to be run and profiled on a machine without a
+  * Geode LX.  This module is only included when CIMARRON_GP_EMULATION is
+  * set, in which case READ_GP32 and WRITE_GP32 are routed through
+  * gp_emu_read32 and gp_emu_write32.  The register file, the command
+  * buffer and every field decoded from them are 32-bit quantities, so the
+  * emulator behaves the same on hosts with 64-bit longs.
+  */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/*-----------------------------*/
+/* GP EMULATOR DEFINITIONS     */
+/*-----------------------------*/
+
+#define GP3_EMU_REGISTER_SIZE               0x4000
+#define GP3_EMU_LUT_SIZE                    0x140
+#define GP3_EMU_LATCH_SIZE                  (GP3_LUT_ADDRESS >> 2)
+#define GP3_EMU_PACKET_TYPE_MASK            0x60000000
+#define GP3_EMU_DATA_TYPE_MASK              0x60000000
+#define GP3_EMU_DATA_COUNT_MASK             0x1FFFFFFF
+#define GP3_EMU_HASH_PRIME                  0x01000193
+
+/* SOURCE CHANNEL TYPES */
+
+#define GP3_EMU_SRC_SOLID                   0
+#define GP3_EMU_SRC_COLOR                   1
+#define GP3_EMU_SRC_MONO                    2
+
+/* CHANNEL 3 USAGE */
+
+#define GP3_EMU_CH3_NONE                    0
+#define GP3_EMU_CH3_SOURCE                  1
+#define GP3_EMU_CH3_PATTERN                 2
+#define GP3_EMU_CH3_COLOR_PAT               3
+#define GP3_EMU_CH3_ALPHA                   4
+
+/*-----------------------------*/
+/* CIMARRON GP EMULATOR GLOBALS */
+/*-----------------------------*/
+
+CIMARRON_STATIC uint32_t gp3_emu_fb_size = 0;
+CIMARRON_STATIC uint32_t gp3_emu_flags = 0;
+CIMARRON_STATIC uint32_t gp3_emu_lut[GP3_EMU_LUT_SIZE];
+CIMARRON_STATIC uint32_t gp3_emu_pending[GP3_EMU_LATCH_SIZE];
+CIMARRON_STATIC uint32_t gp3_emu_host_ch3;
+CIMARRON_STATIC uint32_t gp3_emu_host_needed;
+CIMARRON_STATIC uint32_t gp3_emu_host_count;
+CIMARRON_STATIC uint32_t gp3_emu_host_alloc;
+CIMARRON_STATIC unsigned char *gp3_emu_host_data = (unsigned char *) 0;
+CIMARRON_STATIC GP_EMU_STATS gp3_emu_stats;
+
+/* PACKET ENABLE BIT TO REGISTER TRANSLATION */
+/* Bit n of a BLT or vector header enables the DWORD at offset 4 * (n + 1) */
+/* of the packet.  These tables map each of those DWORDs to the register   */
+/* that it updates.                                                        */
+
+static const uint32_t gp3_emu_blt_regs[16] = {
+    GP3_RASTER_MODE, GP3_DST_OFFSET, GP3_SRC_OFFSET, GP3_STRIDE,
+    GP3_WID_HEIGHT, GP3_SRC_COLOR_FG, GP3_SRC_COLOR_BG, GP3_PAT_COLOR_0,
+    GP3_PAT_COLOR_1, GP3_PAT_DATA_0, GP3_PAT_DATA_1, GP3_CH3_OFFSET,
+    GP3_CH3_MODE_STR, GP3_CH3_WIDHI, GP3_BASE_OFFSET, GP3_BLT_MODE
+};
+
+static const uint32_t gp3_emu_vec_regs[13] = {
+    GP3_RASTER_MODE, GP3_DST_OFFSET, GP3_VEC_ERR, GP3_STRIDE,
+    GP3_VEC_LEN, GP3_SRC_COLOR_FG, GP3_PAT_COLOR_0, GP3_PAT_COLOR_1,
+    GP3_PAT_DATA_0, GP3_PAT_DATA_1, GP3_CH3_MODE_STR, GP3_BASE_OFFSET,
+    GP3_VEC_MODE
+};
+
+#define GP3_EMU_REG(offset) \
+    (*(uint32_t *)(cim_gp_ptr + (offset)))
+
+#define GP3_EMU_CMD(offset) \
+    (*(uint32_t *)(cim_cmd_base_ptr + (offset)))
+
+/*---------------------------------------------------------------------------
+ * gp_emu_pixel_bytes
+ *
+ * This routine returns the number of bytes occupied by one pixel of the
+ * specified channel 3 format.  The raster mode formats use the same
+ * encoding in bits 31:28.  4BPP formats return 0.
+ *-------------------------------------------------------------------------*/
+
+static uint32_t
+gp_emu_pixel_bytes(uint32_t format)
+{
+    switch (format) {
+    case 0x0:
+    case 0x1:
+    case 0x2:
+        return 1;
+    case 0x4:
+    case 0x5:
+    case 0x6:
+    case 0x7:
+        return 2;
+    case 0xB:
+        return 3;
+    case 0xD:
+    case 0xE:
+        return 0;
+    default:
+        return 4;
+    }
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_to_argb
+ *
+ * This routine expands a pixel of the specified format to 8:8:8:8.  Bit
+ * replication is used such that converting back to the original format is
+ * lossless.
+ *-------------------------------------------------------------------------*/
+
+static uint32_t
+gp_emu_to_argb(uint32_t pixel, uint32_t format)
+{
+    uint32_t a, r, g, b;
+
+    switch (format) {
+    case 0x0:
+        r = (pixel >> 5) & 7;
+        g = (pixel >> 2) & 7;
+        r = (r << 5) | (r << 2) | (r >> 1);
+        g = (g << 5) | (g << 2) | (g >> 1);
+        b = (pixel & 3) * 0x55;
+        return 0xFF000000 | (r << 16) | (g << 8) | b;
+
+    case 0x1:
+    case 0xD:
+        return gp3_emu_lut[pixel & 0xFF];
+
+    case 0x2:
+        return (pixel & 0xFF) << 24;
+
+    case 0xE:
+        return ((pixel & 0xF) * 0x11) << 24;
+
+    case 0x4:
+        a = ((pixel >> 12) & 0xF) * 0x11;
+        r = ((pixel >> 8) & 0xF) * 0x11;
+        g = ((pixel >> 4) & 0xF) * 0x11;
+        b = (pixel & 0xF) * 0x11;
+        return (a << 24) | (r << 16) | (g << 8) | b;
+
+    case 0x5:
+        a = (pixel & 0x8000) ? 0xFF : 0;
+        r = (pixel >> 10) & 0x1F;
+        g = (pixel >> 5) & 0x1F;
+        b = pixel & 0x1F;
+        r = (r << 3) | (r >> 2);
+        g = (g << 3) | (g >> 2);
+        b = (b << 3) | (b >> 2);
+        return (a << 24) | (r << 16) | (g << 8) | b;
+
+    case 0x6:
+        r = (pixel >> 11) & 0x1F;
+        g = (pixel >> 5) & 0x3F;
+        b = pixel & 0x1F;
+        r = (r << 3) | (r >> 2);
+        g = (g << 2) | (g >> 4);
+        b = (b << 3) | (b >> 2);
+        return 0xFF000000 | (r << 16) | (g << 8) | b;
+
+    case 0xB:
+        return 0xFF000000 | (pixel & 0xFFFFFF);
+
+    default:
+        return pixel;
+    }
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_from_argb
+ *
+ * This routine packs an 8:8:8:8 pixel into one of the destination formats
+ * supported by the raster mode register.
+ *-------------------------------------------------------------------------*/
+
+static uint32_t
+gp_emu_from_argb(uint32_t argb, uint32_t format)
+{
+    uint32_t a = argb >> 24;
+    uint32_t r = (argb >> 16) & 0xFF;
+    uint32_t g = (argb >> 8) & 0xFF;
+    uint32_t b = argb & 0xFF;
+
+    switch (format) {
+    case 0x0:
+        return (r & 0xE0) | ((g >> 3) & 0x1C) | (b >> 6);
+    case 0x4:
+        return ((a & 0xF0) << 8) | ((r & 0xF0) << 4) | (g & 0xF0) | (b >> 4);
+    case 0x5:
+        return ((a & 0x80) << 8) | ((r & 0xF8) << 7) | ((g & 0xF8) << 2) |
+            (b >> 3);
+    case 0x6:
+        return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+    default:
+        return argb;
+    }
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_fb_address
+ *
+ * This routine converts a GP physical address into a pointer into the
+ * emulated frame buffer.  NULL is returned for any access that falls
+ * outside of the frame buffer.
+ *-------------------------------------------------------------------------*/
+
+static unsigned char *
+gp_emu_fb_address(uint32_t address, uint32_t bytes)
+{
+    address -= gp3_fb_base << 24;
+
+    if (address >= gp3_emu_fb_size || bytes > gp3_emu_fb_size - address) {
+        gp3_emu_stats.errors++;
+        return (unsigned char *) 0;
+    }
+    return cim_fb_ptr + address;
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_read_raw
+ *
+ * This routine reads a 1, 2, 3 or 4 byte little-endian pixel.
+ *-------------------------------------------------------------------------*/
+
+static uint32_t
+gp_emu_read_raw(unsigned char *ptr, uint32_t bytes)
+{
+    uint32_t value = ptr[0];
+
+    if (bytes > 1)
+        value |= (uint32_t) ptr[1] << 8;
+    if (bytes > 2)
+        value |= (uint32_t) ptr[2] << 16;
+    if (bytes > 3)
+        value |= (uint32_t) ptr[3] << 24;
+    return value;
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_write_raw
+ *
+ * This routine writes a 1, 2, 3 or 4 byte little-endian pixel.
+ *-------------------------------------------------------------------------*/
+
+static void
+gp_emu_write_raw(unsigned char *ptr, uint32_t bytes, uint32_t value)
+{
+    ptr[0] = (unsigned char) value;
+    if (bytes > 1)
+        ptr[1] = (unsigned char) (value >> 8);
+    if (bytes > 2)
+        ptr[2] = (unsigned char) (value >> 16);
+    if (bytes > 3)
+        ptr[3] = (unsigned char) (value >> 24);
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_rop
+ *
+ * This routine applies a ternary raster operation.  Each bit of the ROP
+ * selects the output for one combination of pattern, source and
+ * destination bits.
+ *-------------------------------------------------------------------------*/
+
+static uint32_t
+gp_emu_rop(uint32_t rop, uint32_t pat, uint32_t src,
+           uint32_t dst)
+{
+    uint32_t result = 0;
+
+    if (rop & 0x01)
+        result |= ~pat & ~src & ~dst;
+    if (rop & 0x02)
+        result |= ~pat & ~src & dst;
+    if (rop & 0x04)
+        result |= ~pat & src & ~dst;
+    if (rop & 0x08)
+        result |= ~pat & src & dst;
+    if (rop & 0x10)
+        result |= pat & ~src & ~dst;
+    if (rop & 0x20)
+        result |= pat & ~src & dst;
+    if (rop & 0x40)
+        result |= pat & src & ~dst;
+    if (rop & 0x80)
+        result |= pat & src & dst;
+
+    return result;
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_blend
+ *
+ * This routine performs the alpha blend selected by the raster mode
+ * register.  All operands are 8:8:8:8.  'ch3_alpha' is the alpha value
+ * produced by channel 3 before color conversion.
+ *-------------------------------------------------------------------------*/
+
+static uint32_t
+gp_emu_blend(uint32_t raster_mode, uint32_t src, uint32_t dst,
+             uint32_t ch3_alpha)
+{
+    uint32_t chan_a, chan_b, alpha, result = 0;
+    uint32_t a, b, value;
+    int shift;
+
+    if (raster_mode & GP3_RM_DEST_FROM_CHAN_A) {
+        chan_a = dst;
+        chan_b = src;
+    }
+    else {
+        chan_a = src;
+        chan_b = dst;
+    }
+
+    for (shift = 0; shift < 32; shift += 8) {
+        a = (chan_a >> shift) & 0xFF;
+        b = (chan_b >> shift) & 0xFF;
+
+        /* COMPONENTS NOT SELECTED FOR BLENDING PASS THROUGH FROM A */
+
+        if ((shift == 24 && !(raster_mode & GP3_RM_ALPHA_TO_ALPHA)) ||
+            (shift != 24 && !(raster_mode & GP3_RM_ALPHA_TO_RGB))) {
+            result |= a << shift;
+            continue;
+        }
+
+        switch (raster_mode & GP3_RM_ALPHA_SELECT) {
+        case GP3_RM_SELECT_ALPHA_A:
+            alpha = chan_a >> 24;
+            break;
+        case GP3_RM_SELECT_ALPHA_B:
+            alpha = chan_b >> 24;
+            break;
+        case GP3_RM_SELECT_ALPHA_R:
+            alpha = raster_mode & 0xFF;
+            break;
+        case GP3_RM_SELECT_ALPHA_CHAN_A:
+            alpha = a;
+            break;
+        case GP3_RM_SELECT_ALPHA_CHAN_B:
+            alpha = b;
+            break;
+        case GP3_RM_SELECT_ALPHA_CHAN_3:
+            alpha = ch3_alpha;
+            break;
+        default:
+            alpha = 0xFF;
+            break;
+        }
+
+        switch (raster_mode & GP3_RM_ALPHA_OP_MASK) {
+        case GP3_RM_ALPHA_TIMES_A:
+            value = (a * alpha + 127) / 255;
+            break;
+        case GP3_RM_BETA_TIMES_B:
+            value = (b * (255 - alpha) + 127) / 255;
+            break;
+        case GP3_RM_A_PLUS_BETA_B:
+            value = a + (b * (255 - alpha) + 127) / 255;
+            break;
+        default:
+            value = (a * alpha + b * (255 - alpha) + 127) / 255;
+            break;
+        }
+
+        if (value > 0xFF)
+            value = 0xFF;
+        result |= value << shift;
+    }
+
+    return result;
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_read_ch3
+ *
+ * This routine fetches one channel 3 pixel and expands it to 8:8:8:8.
+ * 'line' is the address of the first byte of the line, either a GP
+ * address or an offset into 'host' for host source data.  'index' is the
+ * signed pixel index within the line and 'nibble' selects the starting
+ * nibble for 4BPP formats.
+ *-------------------------------------------------------------------------*/
+
+static uint32_t
+gp_emu_read_ch3(unsigned char *host, uint32_t line, int32_t index,
+                uint32_t format, uint32_t nibble, uint32_t mode)
+{
+    uint32_t bytes = gp_emu_pixel_bytes(format);
+    uint32_t pixel, argb;
+    unsigned char *ptr;
+    int32_t position;
+
+    if (!bytes) {
+        /* 4BPP DATA */
+        /* The first pixel of each byte is stored in the low nibble. */
+
+        position = index + (int32_t) nibble;
+        line += position >> 1;
+        ptr = host ? host + line : gp_emu_fb_address(line, 1);
+        if (!ptr)
+            return 0;
+
+        pixel = *ptr;
+        if (position & 1)
+            pixel >>= 4;
+        pixel &= 0xF;
+    }
+    else {
+        /* NEGATIVE X LINES POINT TO THE LAST BYTE OF THE FIRST PIXEL */
+
+        if (mode & GP3_CH3_NEG_XDIR)
+            line += 1 - bytes;
+        line += index * (int32_t) bytes;
+
+        ptr = host ? host + line : gp_emu_fb_address(line, bytes);
+        if (!ptr)
+            return 0;
+
+        pixel = gp_emu_read_raw(ptr, bytes);
+    }
+
+    if (format == 0x7) {
+        /* YUV SOURCE DATA IS NOT SUPPORTED */
+
+        gp3_emu_stats.errors++;
+        return 0;
+    }
+
+    argb = gp_emu_to_argb(pixel, format);
+
+    if (mode & GP3_CH3_BGR_ORDER) {
+        argb = (argb & 0xFF00FF00) | ((argb >> 16) & 0xFF) |
+            ((argb & 0xFF) << 16);
+    }
+
+    return argb;
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_host_pitch
+ *
+ * This routine returns the number of bytes of host data that a BLT expects
+ * for each line, or 0 if the host data is byte-packed.  'regs' is the
+ * register image of the BLT.
+ *-------------------------------------------------------------------------*/
+
+static uint32_t
+gp_emu_host_pitch(uint32_t *regs, int ch3)
+{
+    uint32_t width = regs[GP3_WID_HEIGHT >> 2] >> 16;
+    uint32_t blt_mode = regs[GP3_BLT_MODE >> 2];
+    uint32_t bytes, format, indent;
+
+    if (ch3) {
+        format = (regs[GP3_CH3_MODE_STR >> 2] >> 24) & 0xF;
+        indent = regs[GP3_CH3_OFFSET >> 2] & 3;
+
+        if (format == 0xB)
+            bytes = width * 3;
+        else if (!gp_emu_pixel_bytes(format))
+            bytes = ((width + ((regs[GP3_CH3_OFFSET >> 2] >> 25) & 1) +
+                      1) >> 1) + indent;
+        else
+            bytes = (width * gp_emu_pixel_bytes(format)) + indent;
+    }
+    else {
+        indent = regs[GP3_SRC_OFFSET >> 2] & 3;
+
+        if (blt_mode & GP3_BM_SRC_BP_MONO)
+            return 0;
+        else if (blt_mode & GP3_BM_SRC_MONO)
+            bytes = ((width + ((regs[GP3_SRC_OFFSET >> 2] >> 26) & 7) +
+                      7) >> 3) + indent;
+        else
+            bytes = width * gp_emu_pixel_bytes(regs[GP3_RASTER_MODE >> 2] >>
+                                               28) + indent;
+    }
+
+    return (bytes + 3) & ~3;
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_execute_blt
+ *
+ * This routine renders one BLT.  'regs' is an image of the GP register file
+ * at the time the BLT was started and 'host' points to the host source
+ * data for BLTs that use it.  Pixels are processed in the same order as
+ * the hardware, such that overlapping BLTs behave identically.
+ *-------------------------------------------------------------------------*/
+
+static void
+gp_emu_execute_blt(uint32_t *regs, unsigned char *host)
+{
+    uint32_t raster_mode = regs[GP3_RASTER_MODE >> 2];
+    uint32_t blt_mode = regs[GP3_BLT_MODE >> 2];
+    uint32_t ch3_mode = regs[GP3_CH3_MODE_STR >> 2];
+    uint32_t base = regs[GP3_BASE_OFFSET >> 2];
+    uint32_t width = regs[GP3_WID_HEIGHT >> 2] >> 16;
+    uint32_t height = regs[GP3_WID_HEIGHT >> 2] & 0xFFFF;
+    uint32_t dst_stride = regs[GP3_STRIDE >> 2] & 0xFFFF;
+    uint32_t src_stride = regs[GP3_STRIDE >> 2] >> 16;
+    uint32_t fgcolor = regs[GP3_SRC_COLOR_FG >> 2];
+    uint32_t bgcolor = regs[GP3_SRC_COLOR_BG >> 2];
+    uint32_t dst_format = raster_mode >> 28;
+    uint32_t dst_bytes = gp_emu_pixel_bytes(dst_format);
+    uint32_t ch3_format = (ch3_mode >> 24) & 0xF;
+    uint32_t ch3_nibble = (regs[GP3_CH3_OFFSET >> 2] >> 25) & 1;
+    uint32_t ch3_stride = ch3_mode & GP3_CH3_STRIDE_MASK;
+    uint32_t pat_origin, pat_format = 0, pat_bytes = 0;
+    uint32_t dst_address, src_address = 0, ch3_address = 0;
+    uint32_t mono_bit = 0, src_type, ch3_type;
+    uint32_t pat, src, dst, src_argb, ch3_argb = 0, result;
+    uint32_t i, j, k, cx, cy, px, py;
+    unsigned char *dst_ptr, *ptr, *src_ptr = (unsigned char *) 0;
+    unsigned char *ch3_host = (unsigned char *) 0;
+    int32_t x, y;
+    int alpha = (raster_mode & GP3_RM_ALPHA_ALL) != 0;
+    int draw;
+
+    /* CLASSIFY CHANNEL 3 */
+    /* Channel 3 can replace the source or pattern channels, supply an 8x8 */
+    /* color pattern from the LUT or supply only alpha values.             */
+
+    if (!(ch3_mode & GP3_CH3_C3EN))
+        ch3_type = GP3_EMU_CH3_NONE;
+    else if (ch3_mode & GP3_CH3_COLOR_PAT_ENABLE)
+        ch3_type = GP3_EMU_CH3_COLOR_PAT;
+    else if (ch3_mode & GP3_CH3_REPLACE_SOURCE)
+        ch3_type = GP3_EMU_CH3_SOURCE;
+    else if (alpha && (raster_mode & GP3_RM_ALPHA_SELECT) ==
+             GP3_RM_SELECT_ALPHA_CHAN_3)
+        ch3_type = GP3_EMU_CH3_ALPHA;
+    else
+        ch3_type = GP3_EMU_CH3_PATTERN;
+
+    if (ch3_type == GP3_EMU_CH3_COLOR_PAT) {
+        pat_origin = regs[GP3_CH3_OFFSET >> 2];
+        pat_format = ch3_format;
+        pat_bytes = gp_emu_pixel_bytes(ch3_format);
+    }
+    else
+        pat_origin = regs[GP3_DST_OFFSET >> 2];
+
+    if (ch3_type != GP3_EMU_CH3_NONE && ch3_type != GP3_EMU_CH3_COLOR_PAT) {
+        if (ch3_mode & GP3_CH3_HST_SRC_ENABLE) {
+            ch3_host = host;
+            ch3_stride = gp_emu_host_pitch(regs, 1);
+            ch3_address = regs[GP3_CH3_OFFSET >> 2] & 3;
+        }
+        else {
+            ch3_address = ((base & GP3_BASE_OFFSET_CH3MASK) << 20) +
+                (regs[GP3_CH3_OFFSET >> 2] & 0x3FFFFF);
+        }
+    }
+
+    /* CLASSIFY THE SOURCE CHANNEL */
+
+    if (blt_mode & (GP3_BM_SRC_MONO | GP3_BM_SRC_BP_MONO))
+        src_type = GP3_EMU_SRC_MONO;
+    else if (blt_mode & (GP3_BM_SRC_FB | GP3_BM_SRC_HOST))
+        src_type = GP3_EMU_SRC_COLOR;
+    else
+        src_type = GP3_EMU_SRC_SOLID;
+
+    if (src_type == GP3_EMU_SRC_MONO) {
+        mono_bit = (regs[GP3_SRC_OFFSET >> 2] >> 26) & 7;
+        if (blt_mode & GP3_BM_SRC_BP_MONO)
+            src_stride = (width + mono_bit + 7) >> 3;
+    }
+
+    if (src_type != GP3_EMU_SRC_SOLID) {
+        if ((blt_mode & GP3_BM_SRC_HOST) && !ch3_host) {
+            src_ptr = host + (regs[GP3_SRC_OFFSET >> 2] & 3);
+            if (!(blt_mode & GP3_BM_SRC_BP_MONO))
+                src_stride = gp_emu_host_pitch(regs, 0);
+        }
+        else {
+            src_address = ((base & GP3_BASE_OFFSET_SRCMASK) << 10) +
+                (regs[GP3_SRC_OFFSET >> 2] & 0x3FFFFF);
+        }
+    }
+
+    dst_address = (base & GP3_BASE_OFFSET_DSTMASK) +
+        (regs[GP3_DST_OFFSET >> 2] & 0x3FFFFF);
+
+    /* NEGATIVE X BLTS POINT TO THE LAST BYTE OF THE FIRST PIXEL */
+
+    if (blt_mode & GP3_BM_NEG_XDIR) {
+        dst_address += 1 - dst_bytes;
+        if (src_type == GP3_EMU_SRC_COLOR)
+            src_address += 1 - dst_bytes;
+    }
+
+    gp3_emu_stats.pixels += width * height;
+
+    for (j = 0; j < height; j++) {
+        y = (blt_mode & GP3_BM_NEG_YDIR) ? -(int32_t) j : (int32_t) j;
+        py = ((pat_origin >> 29) + y) & 7;
+
+        for (i = 0; i < width; i++) {
+            x = (blt_mode & GP3_BM_NEG_XDIR) ? -(int32_t) i : (int32_t) i;
+            px = (((pat_origin >> 26) & 7) + x) & 7;
+            draw = 1;
+
+            dst_ptr = gp_emu_fb_address(dst_address + x * (int32_t) dst_bytes +
+                                        y * (int32_t) dst_stride, dst_bytes);
+            if (!dst_ptr)
+                continue;
+
+            dst = gp_emu_read_raw(dst_ptr, dst_bytes);
+
+            /* FETCH CHANNEL 3 */
+            /* Rotation swaps the roles of the BLT row and column. */
+
+            if (ch3_type != GP3_EMU_CH3_NONE &&
+                ch3_type != GP3_EMU_CH3_COLOR_PAT) {
+                if (ch3_mode & GP3_CH3_ROTATE_ENABLE) {
+                    cx = j;
+                    cy = i;
+                }
+                else {
+                    cx = i;
+                    cy = j;
+                }
+
+                ch3_argb = gp_emu_read_ch3(ch3_host, ch3_address +
+                                           ((ch3_mode & GP3_CH3_NEG_YDIR) ?
+                                            -(int32_t) cy : (int32_t) cy) *
+                                           (int32_t) ch3_stride,
+                                           (ch3_mode & GP3_CH3_NEG_XDIR) ?
+                                           -(int32_t) cx : (int32_t) cx,
+                                           ch3_format, ch3_nibble, ch3_mode);
+            }
+
+            /* DETERMINE PATTERN */
+
+            if (ch3_type == GP3_EMU_CH3_PATTERN)
+                pat = gp_emu_from_argb(ch3_argb, dst_format);
+            else if (ch3_type == GP3_EMU_CH3_COLOR_PAT) {
+                k = ((py << 3) + px) * pat_bytes;
+                pat = 0;
+                for (cx = 0; cx < pat_bytes; cx++, k++) {
+                    pat |= ((gp3_emu_lut[0x100 + (k >> 2)] >>
+                             ((k & 3) << 3)) & 0xFF) << (cx << 3);
+                }
+                pat = gp_emu_from_argb(gp_emu_to_argb(pat, pat_format),
+                                       dst_format);
+            }
+            else if (raster_mode & GP3_RM_PAT_MONO) {
+                k = (regs[(py < 4 ? GP3_PAT_DATA_0 : GP3_PAT_DATA_1) >> 2] >>
+                     ((py & 3) << 3)) & 0xFF;
+                k = (k >> (7 - px)) & 1;
+                if (raster_mode & GP3_RM_PATTERN_INVERT)
+                    k ^= 1;
+                if (!k && (raster_mode & GP3_RM_PAT_TRANS))
+                    draw = 0;
+                pat = regs[(k ? GP3_PAT_COLOR_1 : GP3_PAT_COLOR_0) >> 2];
+            }
+            else
+                pat = regs[GP3_PAT_COLOR_0 >> 2];
+
+            /* DETERMINE SOURCE */
+
+            if (ch3_type == GP3_EMU_CH3_SOURCE) {
+                src_argb = ch3_argb;
+                src = gp_emu_from_argb(ch3_argb, dst_format);
+            }
+            else if (src_type == GP3_EMU_SRC_MONO) {
+                k = mono_bit + i;
+                if (src_ptr)
+                    ptr = src_ptr + j * src_stride + (k >> 3);
+                else {
+                    ptr = gp_emu_fb_address(src_address + j * src_stride +
+                                            (k >> 3), 1);
+                    if (!ptr)
+                        continue;
+                }
+                cx = *ptr;
+                k = (cx >> (7 - (k & 7))) & 1;
+                if (raster_mode & GP3_RM_SOURCE_INVERT)
+                    k ^= 1;
+                if (!k && (raster_mode & GP3_RM_SRC_TRANS))
+                    draw = 0;
+                src = k ? fgcolor : bgcolor;
+                src_argb = gp_emu_to_argb(src, dst_format);
+            }
+            else if (src_type == GP3_EMU_SRC_COLOR) {
+                if (src_ptr) {
+                    src = gp_emu_read_raw(src_ptr + j * src_stride +
+                                          i * dst_bytes, dst_bytes);
+                }
+                else {
+                    ptr = gp_emu_fb_address(src_address +
+                                            x * (int32_t) dst_bytes +
+                                            y * (int32_t) src_stride, dst_bytes);
+                    if (!ptr)
+                        continue;
+                    src = gp_emu_read_raw(ptr, dst_bytes);
+                }
+                src_argb = gp_emu_to_argb(src, dst_format);
+            }
+            else {
+                src = fgcolor;
+                src_argb = gp_emu_to_argb(src, dst_format);
+            }
+
+            /* COLOR SOURCE TRANSPARENCY */
+
+            if (src_type != GP3_EMU_SRC_MONO &&
+                (raster_mode & GP3_RM_SRC_TRANS) &&
+                !((src ^ fgcolor) & bgcolor)) {
+                draw = 0;
+            }
+
+            if (!draw)
+                continue;
+
+            /* COMBINE */
+
+            if (alpha) {
+                result = gp_emu_blend(raster_mode, src_argb,
+                                      gp_emu_to_argb(dst, dst_format),
+                                      ch3_argb >> 24);
+                result = gp_emu_from_argb(result, dst_format);
+            }
+            else
+                result = gp_emu_rop(raster_mode & 0xFF, pat, src, dst);
+
+            gp_emu_write_raw(dst_ptr, dst_bytes, result);
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_execute_vector
+ *
+ * This routine renders one Bresenham vector from an image of the GP
+ * register file.
+ *-------------------------------------------------------------------------*/
+
+static void
+gp_emu_execute_vector(uint32_t *regs)
+{
+    uint32_t raster_mode = regs[GP3_RASTER_MODE >> 2];
+    uint32_t vec_mode = regs[GP3_VEC_MODE >> 2];
+    uint32_t ch3_mode = regs[GP3_CH3_MODE_STR >> 2];
+    uint32_t dst_stride = regs[GP3_STRIDE >> 2] & 0xFFFF;
+    uint32_t dst_format = raster_mode >> 28;
+    uint32_t dst_bytes = gp_emu_pixel_bytes(dst_format);
+    uint32_t length = regs[GP3_VEC_LEN >> 2] >> 16;
+    uint32_t pat_origin = regs[GP3_DST_OFFSET >> 2];
+    uint32_t pattern = gp3_emu_lut[0x100];
+    uint32_t mask = gp3_emu_lut[0x101];
+    uint32_t address, pat, dst, bit, px, py;
+    uint32_t i, pat_length = 0;
+    unsigned char *dst_ptr;
+    int32_t err = (short) (regs[GP3_VEC_LEN >> 2] & 0xFFFF);
+    int32_t axialerr = (short) (regs[GP3_VEC_ERR >> 2] >> 16);
+    int32_t diagerr = (short) (regs[GP3_VEC_ERR >> 2] & 0xFFFF);
+    int32_t major, minor, x = 0, y = 0;
+    int32_t *major_pos, *minor_pos;
+
+    address = (regs[GP3_BASE_OFFSET >> 2] & GP3_BASE_OFFSET_DSTMASK) +
+        (regs[GP3_DST_OFFSET >> 2] & 0x3FFFFF);
+
+    major = (vec_mode & CIMGP_POSMAJOR) ? 1 : -1;
+    minor = (vec_mode & CIMGP_POSMINOR) ? 1 : -1;
+
+    if (vec_mode & CIMGP_YMAJOR) {
+        major_pos = &y;
+        minor_pos = &x;
+    }
+    else {
+        major_pos = &x;
+        minor_pos = &y;
+    }
+
+    /* VECTOR PATTERNS ARE STORED IN THE LUT AS A DATA/MASK PAIR */
+
+    if ((ch3_mode & GP3_CH3_C3EN) && (ch3_mode & GP3_CH3_COLOR_PAT_ENABLE)) {
+        while (pat_length < 32 && (mask & (1U << pat_length)))
+            pat_length++;
+        if (!pat_length)
+            pat_length = 32;
+    }
+
+    gp3_emu_stats.pixels += length;
+
+    for (i = 0; i < length; i++) {
+        px = (((pat_origin >> 26) & 7) + x) & 7;
+        py = ((pat_origin >> 29) + y) & 7;
+
+        if (pat_length)
+            bit = (pattern >> (i % pat_length)) & 1;
+        else
+            bit = 1;
+
+        dst_ptr = gp_emu_fb_address(address + x * (int32_t) dst_bytes +
+                                    y * (int32_t) dst_stride, dst_bytes);
+
+        if (dst_ptr && bit) {
+            dst = gp_emu_read_raw(dst_ptr, dst_bytes);
+
+            if (!pat_length && (raster_mode & GP3_RM_PAT_MONO)) {
+                bit = (regs[(py < 4 ? GP3_PAT_DATA_0 : GP3_PAT_DATA_1) >> 2]
+                       >> (((py & 3) << 3) + 7 - px)) & 1;
+                if (raster_mode & GP3_RM_PATTERN_INVERT)
+                    bit ^= 1;
+                pat = regs[(bit ? GP3_PAT_COLOR_1 : GP3_PAT_COLOR_0) >> 2];
+                if (!bit && (raster_mode & GP3_RM_PAT_TRANS))
+                    dst_ptr = (unsigned char *) 0;
+            }
+            else
+                pat = regs[GP3_PAT_COLOR_0 >> 2];
+
+            if (dst_ptr) {
+                gp_emu_write_raw(dst_ptr, dst_bytes,
+                                 gp_emu_rop(raster_mode & 0xFF, pat,
+                                            regs[GP3_SRC_COLOR_FG >> 2], dst));
+            }
+        }
+
+        /* ADVANCE */
+
+        if (err >= 0) {
+            *minor_pos += minor;
+            err += diagerr;
+        }
+        else
+            err += axialerr;
+        *major_pos += major;
+    }
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_host_data
+ *
+ * This routine appends host source data to the pending BLT.  The BLT is
+ * rendered once all of its data has arrived.
+ *-------------------------------------------------------------------------*/
+
+static void
+gp_emu_host_data(uint32_t offset, uint32_t type,
+                 uint32_t dwords)
+{
+    uint32_t bytes = dwords << 2;
+
+    gp3_emu_stats.host_bytes += bytes;
+
+    if (!gp3_emu_host_needed ||
+        (type == GP3_CH3_HOST_SOURCE_TYPE) != (gp3_emu_host_ch3 != 0)) {
+        gp3_emu_stats.errors++;
+        return;
+    }
+
+    if (bytes > gp3_emu_host_needed - gp3_emu_host_count)
+        bytes = gp3_emu_host_needed - gp3_emu_host_count;
+
+    memcpy(gp3_emu_host_data + gp3_emu_host_count,
+           cim_cmd_base_ptr + offset, bytes);
+    gp3_emu_host_count += bytes;
+
+    if (gp3_emu_host_count == gp3_emu_host_needed) {
+        if (!(gp3_emu_flags & CIMGP_EMU_DECODE_ONLY))
+            gp_emu_execute_blt(gp3_emu_pending, gp3_emu_host_data);
+        gp3_emu_host_needed = 0;
+    }
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_start_blt
+ *
+ * This routine starts a BLT whose registers have been latched into the
+ * register file.  BLTs that require host data are saved until the data
+ * arrives.
+ *-------------------------------------------------------------------------*/
+
+static void
+gp_emu_start_blt(void)
+{
+    uint32_t *regs = (uint32_t *) cim_gp_ptr;
+    uint32_t ch3_mode = regs[GP3_CH3_MODE_STR >> 2];
+    uint32_t blt_mode = regs[GP3_BLT_MODE >> 2];
+    uint32_t height = regs[GP3_WID_HEIGHT >> 2] & 0xFFFF;
+    uint32_t width = regs[GP3_WID_HEIGHT >> 2] >> 16;
+    uint32_t needed;
+    unsigned char *data;
+
+    gp3_emu_stats.blts++;
+
+    if (gp3_emu_host_needed) {
+        /* A NEW BLT WAS STARTED BEFORE ALL HOST DATA ARRIVED */
+
+        gp3_emu_stats.errors++;
+        gp3_emu_host_needed = 0;
+    }
+
+    gp3_emu_host_ch3 = (ch3_mode & GP3_CH3_C3EN) &&
+        (ch3_mode & GP3_CH3_HST_SRC_ENABLE);
+
+    if (!gp3_emu_host_ch3 && !(blt_mode & GP3_BM_SRC_HOST)) {
+        if (!(gp3_emu_flags & CIMGP_EMU_DECODE_ONLY))
+            gp_emu_execute_blt(regs, (unsigned char *) 0);
+        return;
+    }
+
+    /* CALCULATE THE AMOUNT OF HOST DATA */
+    /* Byte-packed monochrome data is only padded at the very end. */
+
+    needed = gp_emu_host_pitch(regs, gp3_emu_host_ch3);
+    if (needed)
+        needed *= height;
+    else
+        needed = ((width + ((regs[GP3_SRC_OFFSET >> 2] >> 26) & 7) + 7) >> 3) *
+            height;
+
+    if (!needed)
+        return;
+
+    if (needed > gp3_emu_host_alloc) {
+        data = (unsigned char *) realloc(gp3_emu_host_data, needed);
+        if (!data) {
+            gp3_emu_stats.errors++;
+            return;
+        }
+        gp3_emu_host_data = data;
+        gp3_emu_host_alloc = needed;
+    }
+
+    memcpy(gp3_emu_pending, regs, sizeof(gp3_emu_pending));
+    gp3_emu_host_needed = needed;
+    gp3_emu_host_count = 0;
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_process
+ *
+ * This routine executes every command between the read and write pointers.
+ * Commands are executed synchronously, so the read pointer always matches
+ * the write pointer on return.
+ *-------------------------------------------------------------------------*/
+
+static void
+gp_emu_process(void)
+{
+    uint32_t read = GP3_EMU_REG(GP3_CMD_READ);
+    uint32_t write = GP3_EMU_REG(GP3_CMD_WRITE);
+    uint32_t top = GP3_EMU_REG(GP3_CMD_TOP);
+    uint32_t bottom = GP3_EMU_REG(GP3_CMD_BOT);
+    uint32_t header, size, count, i;
+
+    gp3_emu_stats.kicks++;
+
+    while (read != write) {
+        if (read < top || read + 4 > bottom) {
+            gp3_emu_stats.errors++;
+            break;
+        }
+
+        header = GP3_EMU_CMD(read);
+
+        switch (header & GP3_EMU_PACKET_TYPE_MASK) {
+        case GP3_BLT_HDR_TYPE:
+            size = GP3_BLT_COMMAND_SIZE;
+            for (i = 0; i < 16; i++) {
+                if (header & (1U << i)) {
+                    GP3_EMU_REG(gp3_emu_blt_regs[i]) =
+                        GP3_EMU_CMD(read + ((i + 1) << 2));
+                }
+            }
+            gp_emu_start_blt();
+            break;
+
+        case GP3_VEC_HDR_TYPE:
+            size = GP3_VECTOR_COMMAND_SIZE;
+            for (i = 0; i < 13; i++) {
+                if (header & (1U << i)) {
+                    GP3_EMU_REG(gp3_emu_vec_regs[i]) =
+                        GP3_EMU_CMD(read + ((i + 1) << 2));
+                }
+            }
+            gp3_emu_stats.vectors++;
+            if (!(gp3_emu_flags & CIMGP_EMU_DECODE_ONLY))
+                gp_emu_execute_vector((uint32_t *) cim_gp_ptr);
+            break;
+
+        case GP3_LUT_HDR_TYPE:
+            count = GP3_EMU_CMD(read + 8) & GP3_EMU_DATA_COUNT_MASK;
+            size = 12 + (count << 2);
+            for (i = 0; i < count; i++) {
+                if (GP3_EMU_CMD(read + 4) + i < GP3_EMU_LUT_SIZE) {
+                    gp3_emu_lut[GP3_EMU_CMD(read + 4) + i] =
+                        GP3_EMU_CMD(read + 12 + (i << 2));
+                }
+            }
+            gp3_emu_stats.lut_loads++;
+            break;
+
+        default:
+            count = GP3_EMU_CMD(read + 4) & GP3_EMU_DATA_COUNT_MASK;
+            size = 8 + (count << 2);
+            if ((GP3_EMU_CMD(read + 4) & GP3_EMU_DATA_TYPE_MASK) ==
+                GP3_OLD_PATTERN_COLORS) {
+                for (i = 0; i < count && i < 4; i++) {
+                    GP3_EMU_REG(GP3_PAT_COLOR_2 + (i << 2)) =
+                        GP3_EMU_CMD(read + 8 + (i << 2));
+                }
+            }
+            else if ((GP3_EMU_CMD(read + 4) & GP3_EMU_DATA_TYPE_MASK) ==
+                     GP3_LUT_DATA_TYPE) {
+                gp3_emu_stats.errors++;
+            }
+            else {
+                gp_emu_host_data(read + 8,
+                                 GP3_EMU_CMD(read + 4) &
+                                 GP3_EMU_DATA_TYPE_MASK, count);
+            }
+            gp3_emu_stats.data_loads++;
+            break;
+        }
+
+        /* UPDATE THE COMMAND STREAM SIGNATURE */
+
+        for (i = 0; i < size; i += 4) {
+            gp3_emu_stats.stream_hash = (uint32_t)
+                ((gp3_emu_stats.stream_hash ^ GP3_EMU_CMD(read + i)) *
+                 GP3_EMU_HASH_PRIME);
+        }
+
+        /* ADVANCE THE READ POINTER */
+
+        if (header & GP3_BLT_HDR_WRAP) {
+            gp3_emu_stats.wraps++;
+            read = top;
+        }
+        else
+            read += size;
+    }
+
+    GP3_EMU_REG(GP3_CMD_READ) = write;
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_read32
+ *
+ * This routine replaces READ_GP32 when the emulator is enabled.  The BLT
+ * status register is synthesized from the state of the command buffer.
+ *-------------------------------------------------------------------------*/
+
+unsigned long
+gp_emu_read32(unsigned long offset)
+{
+    uint32_t status = 0;
+
+    if (offset == GP3_BLT_STATUS) {
+        if (gp3_emu_host_needed)
+            status |= GP3_BS_BLT_BUSY;
+        else if (GP3_EMU_REG(GP3_CMD_READ) == GP3_EMU_REG(GP3_CMD_WRITE))
+            status |= GP3_BS_CB_EMPTY;
+        return status | GP3_BS_HALF_EMPTY;
+    }
+
+    return GP3_EMU_REG(offset);
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_write32
+ *
+ * This routine replaces WRITE_GP32 when the emulator is enabled.  Writing
+ * the command buffer write pointer executes all queued commands.  Writing
+ * the read pointer resets the write pointer, as on the hardware.
+ *-------------------------------------------------------------------------*/
+
+void
+gp_emu_write32(unsigned long offset, unsigned long value)
+{
+    GP3_EMU_REG(offset) = value;
+
+    if (offset == GP3_CMD_READ)
+        GP3_EMU_REG(GP3_CMD_WRITE) = value;
+    else if (offset == GP3_CMD_WRITE)
+        gp_emu_process();
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_init
+ *
+ * This routine allocates an emulated register file and frame buffer, points
+ * the Cimarron memory pointers at them and initializes the GP.  The command
+ * buffer is placed inside the frame buffer at 'cmd_offset', as in the
+ * driver.  Setting CIMGP_EMU_DECODE_ONLY in 'flags' skips all rendering,
+ * which allows the cost of building the command stream to be measured on
+ * its own.
+ *-------------------------------------------------------------------------*/
+
+int
+gp_emu_init(unsigned long fb_size, unsigned long cmd_offset,
+            unsigned long cmd_size, unsigned long flags)
+{
+    if (cmd_offset + cmd_size > fb_size ||
+        cmd_size <= GP3_MAX_COMMAND_SIZE + GP3_BLT_1PASS_SIZE + 72)
+        return CIM_STATUS_INVALIDPARAMS;
+
+    gp_emu_shutdown();
+
+    cim_gp_ptr = (unsigned char *) calloc(1, GP3_EMU_REGISTER_SIZE);
+    cim_fb_ptr = (unsigned char *) calloc(1, fb_size);
+
+    if (!cim_gp_ptr || !cim_fb_ptr) {
+        gp_emu_shutdown();
+        return CIM_STATUS_ERROR;
+    }
+
+    cim_cmd_base_ptr = cim_fb_ptr + cmd_offset;
+    gp3_emu_fb_size = fb_size;
+    gp3_emu_flags = flags;
+
+    memset(gp3_emu_lut, 0, sizeof(gp3_emu_lut));
+    memset(&gp3_emu_stats, 0, sizeof(gp3_emu_stats));
+
+    gp_set_frame_buffer_base(0, fb_size);
+    gp_set_command_buffer_base(cmd_offset, 0, cmd_size);
+
+    return CIM_STATUS_OK;
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_shutdown
+ *
+ * This routine frees all memory allocated by gp_emu_init.
+ *-------------------------------------------------------------------------*/
+
+void
+gp_emu_shutdown(void)
+{
+    free(cim_gp_ptr);
+    free(cim_fb_ptr);
+    free(gp3_emu_host_data);
+
+    cim_gp_ptr = cim_fb_ptr = cim_cmd_base_ptr = cim_cmd_ptr =
+        (unsigned char *) 0;
+    gp3_emu_host_data = (unsigned char *) 0;
+    gp3_emu_host_alloc = gp3_emu_host_needed = 0;
+    gp3_emu_fb_size = 0;
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_get_stats
+ *
+ * This routine returns the emulator counters.  The stream hash is a
+ * signature of every command executed and can be compared between runs to
+ * detect changes in the generated command stream.
+ *-------------------------------------------------------------------------*/
+
+void
+gp_emu_get_stats(GP_EMU_STATS * stats)
+{
+    *stats = gp3_emu_stats;
+}
+
+/*---------------------------------------------------------------------------
+ * gp_emu_reset_stats
+ *-------------------------------------------------------------------------*/
+
+void
+gp_emu_reset_stats(void)
+{
+    memset(&gp3_emu_stats, 0, sizeof(gp3_emu_stats));
+}
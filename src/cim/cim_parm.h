@@ -218,6 +218,30 @@ typedef struct tagGPSaveRestore {
 
 } GP_SAVE_RESTORE;
 
+/*------------------------------*/
+/* GP_EMU_INIT PARAMETERS       */
+/*------------------------------*/
+
+#define CIMGP_EMU_DECODE_ONLY            0x0001
+
+/*------------------------------------------*/
+/* USER STRUCTURE FOR GP EMULATOR COUNTERS  */
+/*------------------------------------------*/
+
+typedef struct tagGPEmuStats {
+    unsigned long kicks;
+    unsigned long blts;
+    unsigned long vectors;
+    unsigned long lut_loads;
+    unsigned long data_loads;
+    unsigned long host_bytes;
+    unsigned long pixels;
+    unsigned long wraps;
+    unsigned long errors;
+    unsigned long stream_hash;
+
+} GP_EMU_STATS;
+
 /*===================================================*/
 /*          VG USER PARAMETER DEFINITIONS            */
 /*===================================================*/
@@ -68,6 +68,8 @@ extern "C" {
 /*----------------------------------------*/
 
     void gp_set_limit_on_buffer_lead(unsigned long lead);
+    void gp_set_command_batching(unsigned long limit);
+    void gp_flush_command_buffer(void);
     void gp_set_command_buffer_base(unsigned long address,
                                     unsigned long start, unsigned long stop);
     void gp_set_frame_buffer_base(unsigned long address, unsigned long size);
@@ -150,11 +152,26 @@ extern "C" {
 
     int gp_test_blt_pending(void);
     void gp_wait_blt_pending(void);
+    unsigned long gp_get_command_marker(void);
+    int gp_test_command_marker(unsigned long marker);
+    void gp_wait_command_marker(unsigned long marker);
     void gp_wait_until_idle(void);
     int gp_test_blt_busy(void);
     void gp_save_state(GP_SAVE_RESTORE * gp_state);
     void gp_restore_state(GP_SAVE_RESTORE * gp_state);
 
+/*----------------------------------------*/
+/* GP EMULATOR ROUTINE DEFINITIONS        */
+/*----------------------------------------*/
+
+    int gp_emu_init(unsigned long fb_size, unsigned long cmd_offset,
+                    unsigned long cmd_size, unsigned long flags);
+    void gp_emu_shutdown(void);
+    unsigned long gp_emu_read32(unsigned long offset);
+    void gp_emu_write32(unsigned long offset, unsigned long value);
+    void gp_emu_get_stats(GP_EMU_STATS * stats);
+    void gp_emu_reset_stats(void);
+
 /*----------------------------------------*/
 /* VIDEO GENERATOR ROUTINE DEFINITIONS    */
 /*----------------------------------------*/
@@ -51,6 +51,38 @@
 #define CIMARRON_INCLUDE_VIP_READ_ROUTINES 1
 #define CIMARRON_INCLUDE_VOP_READ_ROUTINES 1
 
+/*----------------------------------------------------------------------*/
+/* GP EMULATION                                                         */
+/* Setting CIMARRON_GP_EMULATION to 1 includes a software GP3 that      */
+/* executes the command buffer on the host CPU.  All GP register        */
+/* accesses are routed to the emulator and the frame buffer and command */
+/* buffer are allocated from system memory by gp_emu_init.  This is     */
+/* intended for profiling and testing without hardware and must not be  */
+/* enabled in the driver.  gpemubench.c is built this way.              */
+/*----------------------------------------------------------------------*/
+
+#ifndef CIMARRON_GP_EMULATION
+#define CIMARRON_GP_EMULATION              0
+#endif
+
+/* ONLY THE GP IS EMULATED.  THE OTHER MODULES, AND INITIALIZATION,  */
+/* PROBE THE HARDWARE THROUGH I/O PORTS AND MSRS, WHICH IS NOT        */
+/* POSSIBLE WHEN EMULATING.                                           */
+
+#if CIMARRON_GP_EMULATION
+#include <stdint.h>
+#undef  CIMARRON_INCLUDE_VG
+#undef  CIMARRON_INCLUDE_VIP
+#undef  CIMARRON_INCLUDE_VOP
+#undef  CIMARRON_INCLUDE_VIDEO
+#undef  CIMARRON_INCLUDE_INIT
+#define CIMARRON_INCLUDE_VG                0
+#define CIMARRON_INCLUDE_VIP               0
+#define CIMARRON_INCLUDE_VOP               0
+#define CIMARRON_INCLUDE_VIDEO             0
+#define CIMARRON_INCLUDE_INIT              0
+#endif
+
 /*----------------------------------------------------------------------*/
 /* HARDWARE ACCESS SETTINGS                                             */
 /* The following #defines affect how the Cimarron macros access the     */
@@ -134,7 +166,9 @@
 #define CIMARRON_MSR_KERNEL_ROUTINE        0
 #define CIMARRON_MSR_HOOKS                 1
 
+#if !CIMARRON_GP_EMULATION
 #define CIMARRON_INCLUDE_IO_MACROS
+#endif
 #define CIMARRON_IO_DIRECT_ACCESS          0
 #define CIMARRON_IO_ABSTRACTED_ASM         1
 
@@ -214,6 +248,12 @@ void (*cim_wrmsr) (unsigned long, unsigned long, unsigned long);
 #include "cim_gp.c"
 #endif
 
+/* GRAPHICS PROCESSOR EMULATION */
+
+#if CIMARRON_INCLUDE_GP && CIMARRON_GP_EMULATION
+#include "cim_gpemu.c"
+#endif
+
 /* VIDEO GENERATOR */
 
 #if CIMARRON_INCLUDE_VG
@@ -181,13 +181,42 @@ typedef struct _VESARec {
     xf86Int10InfoPtr pInt;
 } VESARec;
 
+/* Offscreen memory blocks, see lx_memory.c */
+
+#define GEODE_MEM_BINS 32
+
 typedef struct _GeodeMemRec {
-    struct _GeodeMemRec *next;
+    struct _GeodeMemRec *next;  /* Neighbours in address order */
     struct _GeodeMemRec *prev;
     unsigned int offset;
     int size;
+    ExaOffscreenArea *area;     /* Set when the memory came from EXA */
+    int owner;                  /* GEODE_MEM_*, for LXAllocVideoMem() */
+    Bool isFree;
+    struct _GeodeMemRec *freeNext;      /* Free blocks of the same bin */
+    struct _GeodeMemRec *freePrev;
 } GeodeMemRec, *GeodeMemPtr;
 
+/* Video memory accounting by owner, see geode_common.c */
+
+enum {
+    GEODE_MEM_DISPLAY,
+    GEODE_MEM_COMPRESSION,
+    GEODE_MEM_CURSOR,
+    GEODE_MEM_SCRATCH,          /* The EXA scratch and XAA buffers */
+    GEODE_MEM_EXA,              /* The pool EXA manages itself */
+    GEODE_MEM_PIXMAP,           /* Pixmaps the driver manages */
+    GEODE_MEM_VIDEO,
+    GEODE_MEM_SHADOW,
+    GEODE_MEM_OWNERS
+};
+
+typedef struct _GeodeMemStatsRec {
+    unsigned int used[GEODE_MEM_OWNERS];
+    unsigned int peak[GEODE_MEM_OWNERS];
+    unsigned long failed[GEODE_MEM_OWNERS];
+} GeodeMemStatsRec;
+
 #define OUTPUT_PANEL 0x01
 #define OUTPUT_CRT   0x02
 #define OUTPUT_TV    0x04
@@ -217,7 +246,8 @@ typedef struct _geodeRec {
     int Pitch;                  /* display FB pitch */
     int displaySize;            /* The size of the visibile area */
 
-    ExaOffscreenArea *shadowArea;
+    GeodeMemPtr shadowArea;
+    GeodeMemPtr compressionArea;
 
     /* Framebuffer memory */
 
@@ -260,6 +290,7 @@ typedef struct _geodeRec {
 
     /* Flags */
     Bool Scale;
+    Bool tryMixedPixmaps;
 
     DisplayModePtr panelMode;   /* The mode for the panel (if attached) */
 
@@ -269,8 +300,12 @@ typedef struct _geodeRec {
 
     /* Memory Management */
     GeodeMemPtr offscreenList;
+    GeodeMemPtr offscreenBins[GEODE_MEM_BINS];
+    GeodeMemPtr offscreenSpare;
     unsigned int offscreenStart;
     unsigned int offscreenSize;
+    unsigned int offscreenFree;
+    GeodeMemStatsRec memStats;
 
     /* Save state */
     VG_COMPRESSION_DATA CBData;
@@ -341,6 +376,16 @@ typedef struct _geodeRec {
     BOOL OverlayON;
 } GeodeRec, *GeodePtr;
 
+/* With mixed pixmaps the driver allocates the video memory for pixmaps
+ * itself, and EXA doesn't manage any off-screen memory */
+
+#ifdef EXA_MIXED_PIXMAPS
+#define GEODE_EXA_MIXED(pGeode) \
+    ((pGeode)->pExa && ((pGeode)->pExa->flags & EXA_MIXED_PIXMAPS))
+#else
+#define GEODE_EXA_MIXED(pGeode) FALSE
+#endif
+
 /* option flags are self-explanatory */
 #ifdef HAVE_LX
 enum LX_GeodeOpts {
@@ -356,6 +401,7 @@ enum LX_GeodeOpts {
     LX_OPTION_NOPANEL,
     LX_OPTION_FBSIZE,
     LX_OPTION_PANEL_MODE,
+    LX_OPTION_EXA_MIXED,
     LX_OPTION_DONT_PROGRAM
 };
 #endif
@@ -389,9 +435,21 @@ extern int DCONDPMSSet(ScrnInfoPtr pScrni, int mode);
 
 void geode_memory_to_screen_blt(unsigned long, unsigned long,
                                 unsigned long, unsigned long, long, long, int);
+void geode_stream_to_screen(unsigned char *, unsigned char *, int, int, int,
+                            int);
+#if defined(__i386__) || defined(__x86_64__)
+Bool geode_has_movntq(void);
+#endif
 int GeodeGetRefreshRate(DisplayModePtr);
 void GeodeCopyGreyscale(unsigned char *, unsigned char *, int, int, int, int);
+void GeodeSplitChroma(unsigned char *, unsigned char *, unsigned char *, int,
+                      int, int, int);
 int GeodeGetSizeFromFB(unsigned int *);
+void GeodeMemSetUsed(GeodeRec * pGeode, int owner, unsigned int size);
+void GeodeMemUsed(GeodeRec * pGeode, int owner, int size);
+void GeodeMemFailed(GeodeRec * pGeode, int owner);
+void GeodeMemResetStats(GeodeRec * pGeode);
+void GeodeMemDumpStats(ScrnInfoPtr pScrni);
 
 /* gx_video.c */
 
@@ -456,6 +514,9 @@ void LXShowCursor(ScrnInfoPtr pScrni);
 
 /* lx_exa.c */
 Bool LXExaInit(ScreenPtr pScreen);
+void LXExaDumpFallbacks(ScrnInfoPtr pScrni);
+void LXExaResetFallbacks(void);
+Bool LXExaAttachPixmap(PixmapPtr pPixmap, unsigned int offset, int pitch);
 
 /* lx_video.c */
 void LXInitVideo(ScreenPtr pScrn);
@@ -478,6 +539,14 @@ void GeodeFreeOffscreen(GeodeRec * pGeode, GeodeMemPtr ptr);
 void LXInitOffscreen(ScrnInfoPtr pScrni);
 void GeodeCloseOffscreen(ScrnInfoPtr pScrni);
 unsigned int GeodeOffscreenFreeSize(GeodeRec * pGeode);
+GeodeMemPtr LXAllocVideoMem(ScrnInfoPtr pScrni, int size, int align,
+                            int owner);
+GeodeMemPtr LXTryAllocVideoMem(ScrnInfoPtr pScrni, int size, int align,
+                               int owner);
+void LXFreeVideoMem(ScrnInfoPtr pScrni, GeodeMemPtr ptr);
+GeodeMemPtr LXAllocPixmapMem(GeodeRec * pGeode, int size, int align);
+void LXUpdateOffscreen(ScrnInfoPtr pScrni);
+void LXDumpVideoMem(ScrnInfoPtr pScrni);
 
 /* lx_cursor.c */
 Bool LXCursorInit(ScreenPtr pScrn);
@@ -30,12 +30,15 @@
 #include "config.h"
 #endif
 
-#include <string.h>             /* memcmp() */
+#include <string.h>             /* memcmp(), memcpy() */
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>              /* __get_cpuid() */
+#endif
 
 #include "xf86.h"
 #include "geode.h"
@@ -113,6 +116,177 @@ geode_memory_to_screen_blt(unsigned long src, unsigned long dst,
     }
 }
 
+#if defined(__i386__) || defined(__x86_64__)
+
+/* The LX core has no SSE, but it has the AMD MMX extensions, and with
+   them MOVNTQ.  The stores go to the write combining buffers without
+   the lines being read into the cache first. */
+
+Bool
+geode_has_movntq(void)
+{
+    static int has = -1;
+    unsigned int eax, ebx, ecx, edx;
+
+    if (has < 0) {
+        has = 0;
+
+        if (__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx))
+            has = (edx & (1 << 22)) != 0;
+
+        if (!has && __get_cpuid(1, &eax, &ebx, &ecx, &edx))
+            has = (edx & (1 << 25)) != 0;       /* SSE */
+    }
+
+    return has;
+}
+
+static void
+geode_stream_line(unsigned char *dst, unsigned char *src, int n)
+{
+    while (n > 0 && ((unsigned long) dst & 7)) {
+        *dst++ = *src++;
+        n--;
+    }
+
+    for (; n >= 32; n -= 32, src += 32, dst += 32)
+        __asm__ __volatile__("   movq   (%0), %%mm0\n"
+                             "   movq  8(%0), %%mm1\n"
+                             "   movq 16(%0), %%mm2\n"
+                             "   movq 24(%0), %%mm3\n"
+                             "   movntq %%mm0,   (%1)\n"
+                             "   movntq %%mm1,  8(%1)\n"
+                             "   movntq %%mm2, 16(%1)\n"
+                             "   movntq %%mm3, 24(%1)\n"
+                             :
+                             :"r"(src), "r"(dst)
+                             :"memory", "mm0", "mm1", "mm2", "mm3");
+
+    if (n > 0)
+        memcpy(dst, src, n);
+}
+
+/* Split n interleaved chroma pairs into two planes, eight pairs at a
+   time: the first byte of each pair is kept by masking, the second by
+   shifting, and each set of words is packed back down to bytes. */
+
+static void
+geode_split_line(unsigned char *src, unsigned char *dst0,
+                 unsigned char *dst1, int n)
+{
+    static const unsigned long long mask = 0x00FF00FF00FF00FFULL;
+
+    for (; n >= 8; n -= 8, src += 16, dst0 += 8, dst1 += 8)
+        __asm__ __volatile__("   movq   (%0), %%mm0\n"
+                             "   movq  8(%0), %%mm1\n"
+                             "   movq %%mm0, %%mm2\n"
+                             "   movq %%mm1, %%mm3\n"
+                             "   pand %3, %%mm0\n"
+                             "   pand %3, %%mm1\n"
+                             "   psrlw $8, %%mm2\n"
+                             "   psrlw $8, %%mm3\n"
+                             "   packuswb %%mm1, %%mm0\n"
+                             "   packuswb %%mm3, %%mm2\n"
+                             "   movntq %%mm0, (%1)\n"
+                             "   movntq %%mm2, (%2)\n"
+                             :
+                             :"r"(src), "r"(dst0), "r"(dst1), "m"(mask)
+                             :"memory", "mm0", "mm1", "mm2", "mm3");
+
+    while (n-- > 0) {
+        *dst0++ = *src++;
+        *dst1++ = *src++;
+    }
+}
+
+/* Expand n luma bytes to YUYV with grey chroma, eight at a time: each
+   group is unpacked against a register full of 0x80 */
+
+static void
+geode_grey_line(unsigned char *dst, unsigned char *src, int n)
+{
+    static const unsigned long long grey = 0x8080808080808080ULL;
+
+    for (; n >= 8; n -= 8, src += 8, dst += 16)
+        __asm__ __volatile__("   movq (%0), %%mm0\n"
+                             "   movq %%mm0, %%mm1\n"
+                             "   punpcklbw %2, %%mm0\n"
+                             "   punpckhbw %2, %%mm1\n"
+                             "   movntq %%mm0,  (%1)\n"
+                             "   movntq %%mm1, 8(%1)\n"
+                             :
+                             :"r"(src), "r"(dst), "m"(grey)
+                             :"memory", "mm0", "mm1");
+
+    while (n-- > 0) {
+        *dst++ = *src++;
+        *dst++ = 0x80;
+    }
+}
+
+#endif
+
+/* Copy h lines of n bytes straight into the mapped frame buffer, with
+   streaming stores where the CPU has them */
+
+void
+geode_stream_to_screen(unsigned char *src, unsigned char *dst,
+                       int sp, int dp, int n, int h)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    if (geode_has_movntq()) {
+        while (--h >= 0) {
+            geode_stream_line(dst, src, n);
+            src += sp;
+            dst += dp;
+        }
+
+        __asm__ __volatile__("   sfence\n" "   emms\n":::"memory");
+        return;
+    }
+#endif
+
+    geode_memory_to_screen_blt((unsigned long) src, (unsigned long) dst,
+                               sp, dp, n, h, 8);
+}
+
+/* Copy the interleaved chroma plane of an NV12 or NV21 image into the
+   separate planes the video overlay reads.  The first byte of each pair
+   goes to dst0 and the second to dst1, w pairs for each of h lines. */
+
+void
+GeodeSplitChroma(unsigned char *src, unsigned char *dst0,
+                 unsigned char *dst1, int srcPitch, int dstPitch, int h,
+                 int w)
+{
+    int i;
+
+#if defined(__i386__) || defined(__x86_64__)
+    if (geode_has_movntq()) {
+        while (--h >= 0) {
+            geode_split_line(src, dst0, dst1, w);
+            src += srcPitch;
+            dst0 += dstPitch;
+            dst1 += dstPitch;
+        }
+
+        __asm__ __volatile__("   sfence\n" "   emms\n":::"memory");
+        return;
+    }
+#endif
+
+    while (--h >= 0) {
+        for (i = 0; i < w; i++) {
+            dst0[i] = src[i << 1];
+            dst1[i] = src[(i << 1) + 1];
+        }
+
+        src += srcPitch;
+        dst0 += dstPitch;
+        dst1 += dstPitch;
+    }
+}
+
 /* I borrowed this function from the i830 driver - its much better
    then what we had before
 */
@@ -126,10 +300,11 @@ GeodeGetRefreshRate(DisplayModePtr pMode)
     return (int) (pMode->Clock * 1000.0 / pMode->HTotal / pMode->VTotal + 0.5);
 }
 
-/* This is used by both GX and LX.  It could be accelerated for LX, probably, but
-   that would involve a two pass blt, the first to copy the data, and the second
-   to copy the grey (using a pattern).  That seems like a bit of work for a
-   very underused format - so we'll just use the slow version.
+/* This is used by both GX and LX.  The GP can't spread bytes out to every
+   other byte, so a blt could only fill in the grey after the CPU had placed
+   the luma - which costs as much as writing the grey along with it.  The
+   expansion is done with MMX where the CPU has the extensions, and byte by
+   byte otherwise.
 */
 
 void
@@ -144,6 +319,21 @@ GeodeCopyGreyscale(unsigned char *src, unsigned char *dst,
 
     dstPitch <<= 1;
 
+#if defined(__i386__) || defined(__x86_64__)
+    if (geode_has_movntq()) {
+        while (h--) {
+            geode_grey_line(dst2, src2, w);
+            geode_grey_line(dst2 + (w << 1), src2, w);
+
+            dst2 += dstPitch;
+            src2 += srcPitch;
+        }
+
+        __asm__ __volatile__("   sfence\n" "   emms\n":::"memory");
+        return;
+    }
+#endif
+
     while (h--) {
         dst3 = dst2;
         src3 = src2;
@@ -163,6 +353,76 @@ GeodeCopyGreyscale(unsigned char *src, unsigned char *dst,
     }
 }
 
+/* Video memory accounting.  Each owner keeps its current and peak use,
+   and the number of allocations it failed to get, so that the memory
+   map and exaBfrSz can be sized from what was actually needed.
+*/
+
+static const char *geode_mem_owners[GEODE_MEM_OWNERS] = {
+    "Display",
+    "Compression",
+    "Cursor",
+    "Scratch",
+    "EXA pool",
+    "Pixmaps",
+    "Video",
+    "Rotation",
+};
+
+void
+GeodeMemSetUsed(GeodeRec * pGeode, int owner, unsigned int size)
+{
+    GeodeMemStatsRec *stats = &pGeode->memStats;
+
+    stats->used[owner] = size;
+
+    if (size > stats->peak[owner])
+        stats->peak[owner] = size;
+}
+
+void
+GeodeMemUsed(GeodeRec * pGeode, int owner, int size)
+{
+    GeodeMemSetUsed(pGeode, owner, pGeode->memStats.used[owner] + size);
+}
+
+void
+GeodeMemFailed(GeodeRec * pGeode, int owner)
+{
+    pGeode->memStats.failed[owner]++;
+}
+
+/* Start a new measurement from the current usage */
+
+void
+GeodeMemResetStats(GeodeRec * pGeode)
+{
+    GeodeMemStatsRec *stats = &pGeode->memStats;
+    int i;
+
+    for (i = 0; i < GEODE_MEM_OWNERS; i++) {
+        stats->peak[i] = stats->used[i];
+        stats->failed[i] = 0;
+    }
+}
+
+void
+GeodeMemDumpStats(ScrnInfoPtr pScrni)
+{
+    GeodeMemStatsRec *stats = &GEODEPTR(pScrni)->memStats;
+    int i;
+
+    for (i = 0; i < GEODE_MEM_OWNERS; i++) {
+        if (stats->peak[i] == 0 && stats->failed[i] == 0)
+            continue;
+
+        xf86DrvMsg(pScrni->scrnIndex, X_INFO,
+                   " %-12s 0x%08x bytes, peak 0x%08x, %lu failed\n",
+                   geode_mem_owners[i], stats->used[i], stats->peak[i],
+                   stats->failed[i]);
+    }
+}
+
 #if defined(linux)
 
 #include <linux/fb.h>
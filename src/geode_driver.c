@@ -195,6 +195,7 @@ OptionInfoRec LX_GeodeOptions[] = {
     {LX_OPTION_EXA_SCRATCH_BFRSZ, "ExaScratch", OPTV_INTEGER, {0}, FALSE},
     {LX_OPTION_FBSIZE, "FBSize", OPTV_INTEGER, {0}, FALSE},
     {LX_OPTION_PANEL_MODE, "PanelMode", OPTV_STRING, {0}, FALSE},
+    {LX_OPTION_EXA_MIXED, "ExaMixedPixmaps", OPTV_BOOLEAN, {0}, FALSE},
     {-1, NULL, OPTV_NONE, {0}, FALSE}
 };
 
@@ -87,6 +87,53 @@
 	XvTopToBottom \
    }
 
+/* Planar luma followed by one plane of interleaved chroma, U first for
+   NV12 and V first for NV21.  Newer servers define NV12 themselves. */
+
+#ifndef FOURCC_NV12
+#define FOURCC_NV12 0x3231564E
+#define XVIMAGE_NV12 \
+   { \
+	FOURCC_NV12, \
+        XvYUV, \
+	LSBFirst, \
+	{'N','V','1','2', \
+	  0x00,0x00,0x00,0x10,0x80,0x00,0x00,0xAA,0x00,0x38,0x9B,0x71}, \
+	12, \
+	XvPlanar, \
+	2, \
+	0, 0, 0, 0, \
+	8, 8, 8, \
+	1, 2, 2, \
+	1, 2, 2, \
+	{'Y','U','V', \
+	  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, \
+	XvTopToBottom \
+   }
+#endif
+
+#ifndef FOURCC_NV21
+#define FOURCC_NV21 0x3132564E
+#define XVIMAGE_NV21 \
+   { \
+	FOURCC_NV21, \
+        XvYUV, \
+	LSBFirst, \
+	{'N','V','2','1', \
+	  0x00,0x00,0x00,0x10,0x80,0x00,0x00,0xAA,0x00,0x38,0x9B,0x71}, \
+	12, \
+	XvPlanar, \
+	2, \
+	0, 0, 0, 0, \
+	8, 8, 8, \
+	1, 2, 2, \
+	1, 2, 2, \
+	{'Y','V','U', \
+	  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, \
+	XvTopToBottom \
+   }
+#endif
+
 /* Borrowed from Trident */
 
 #define FOURCC_RGB565 0x36315652
@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2006 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Neither the name of the Advanced Micro Devices, Inc. nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ */
+
+ /*
+  * Cimarron GP benchmark.  This program runs the cim_gp.c primitives that
+  * the driver uses against the software GP in cim_gpemu.c and reports the
+  * cost of each one: the time spent building its commands, the time spent
+  * rendering them, and the commands and host data it generates.  It needs
+  * no hardware.  A few pixels are checked after each primitive, and the
+  * program exits with an error if any of them are wrong.
+  *
+  * Usage: gpemubench [iterations]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CIMARRON_GP_EMULATION 1
+#include "cimarron.c"
+
+#define BENCH_FB_SIZE       (8 << 20)
+#define BENCH_CMD_SIZE      0x200000
+#define BENCH_CMD_OFFSET    (BENCH_FB_SIZE - BENCH_CMD_SIZE)
+#define BENCH_PITCH         4096
+#define BENCH_SCRATCH       (BENCH_CMD_OFFSET - 0x100000)
+
+#define BENCH_OFFSET(x, y)  (((y) * BENCH_PITCH) + ((x) << 2))
+#define BENCH_PIXEL(x, y)   (*(uint32_t *)(cim_fb_ptr + BENCH_OFFSET(x, y)))
+
+typedef struct {
+    const char *name;
+    unsigned long pixels;
+    void (*run) (int);
+    int (*check) (void);
+} BENCH_PRIMITIVE;
+
+static unsigned char bench_host[64 * 64 * 4];
+static unsigned char bench_mono[64 * 64 / 8];
+
+/*---------------------------------------------------------------------------
+ * PRIMITIVES
+ *
+ * Each primitive is issued the way the driver issues it, including the
+ * state set up by gp_declare_blt/gp_declare_vector.
+ *-------------------------------------------------------------------------*/
+
+static void
+bench_solid_fill(int i)
+{
+    gp_declare_blt(0);
+    gp_set_raster_operation(0xF0);
+    gp_set_solid_pattern(0xFF112233);
+    gp_set_strides(BENCH_PITCH, BENCH_PITCH);
+    gp_pattern_fill(BENCH_OFFSET(0, 0), 64, 64);
+}
+
+static int
+bench_solid_fill_check(void)
+{
+    return BENCH_PIXEL(0, 0) == 0xFF112233 && BENCH_PIXEL(63, 63) == 0xFF112233
+        && BENCH_PIXEL(64, 0) != 0xFF112233;
+}
+
+static void
+bench_mono_pattern(int i)
+{
+    gp_declare_blt(0);
+    gp_set_raster_operation(0xF0);
+    gp_set_mono_pattern(0xFF000000, 0xFFFFFFFF, 0xAA55AA55, 0xAA55AA55, 0,
+                        0, 0);
+    gp_set_strides(BENCH_PITCH, BENCH_PITCH);
+    gp_pattern_fill(BENCH_OFFSET(0, 100), 64, 64);
+}
+
+static int
+bench_mono_pattern_check(void)
+{
+    return BENCH_PIXEL(0, 100) != BENCH_PIXEL(1, 100) &&
+        BENCH_PIXEL(0, 100) == BENCH_PIXEL(1, 101);
+}
+
+static void
+bench_copy(int i)
+{
+    gp_declare_blt(0);
+    gp_set_raster_operation(0xCC);
+    gp_set_strides(BENCH_PITCH, BENCH_PITCH);
+    gp_screen_to_screen_blt(BENCH_OFFSET(100, 0), BENCH_OFFSET(0, 0), 64, 64,
+                            0);
+}
+
+static int
+bench_copy_check(void)
+{
+    return BENCH_PIXEL(100, 0) == 0xFF112233 &&
+        BENCH_PIXEL(163, 63) == 0xFF112233;
+}
+
+static void
+bench_upload(int i)
+{
+    gp_declare_blt(0);
+    gp_set_raster_operation(0xCC);
+    gp_set_strides(BENCH_PITCH, 64 * 4);
+    gp_color_bitmap_to_screen_blt(BENCH_OFFSET(200, 0), 0, 64, 64,
+                                  bench_host, 64 * 4);
+}
+
+static int
+bench_upload_check(void)
+{
+    return BENCH_PIXEL(200, 0) == *(uint32_t *) bench_host &&
+        BENCH_PIXEL(263, 63) == *(uint32_t *) (bench_host + sizeof(bench_host)
+                                               - 4);
+}
+
+static void
+bench_text(int i)
+{
+    gp_declare_blt(0);
+    gp_set_raster_operation(0xCC);
+    gp_set_mono_source(0, 0xFFFFFFFF, 1);
+    gp_set_strides(BENCH_PITCH, BENCH_PITCH);
+    gp_text_blt(BENCH_OFFSET(300, 0), 64, 64, bench_mono);
+}
+
+static int
+bench_text_check(void)
+{
+    return BENCH_PIXEL(300, 0) == 0xFFFFFFFF && BENCH_PIXEL(301, 0) == 0;
+}
+
+static void
+bench_blend(int i)
+{
+    gp_declare_blt(0);
+    gp_set_solid_source(0xFFFFFFFF);
+    gp_set_strides(BENCH_PITCH, BENCH_PITCH);
+    gp_blend_mask_blt(BENCH_OFFSET(400, 0), 0, 64, 64, BENCH_SCRATCH, 64,
+                      CIMGP_ALPHA_A_PLUS_BETA_B, 0);
+}
+
+static int
+bench_blend_check(void)
+{
+    return BENCH_PIXEL(400, 0) == 0xFFFFFFFF;
+}
+
+static void
+bench_rotate(int i)
+{
+    gp_declare_blt(0);
+    gp_set_strides(BENCH_PITCH, BENCH_PITCH);
+    gp_set_source_format(CIMGP_SOURCE_FMT_8_8_8_8);
+    gp_rotate_blt(BENCH_OFFSET(500, 0), BENCH_OFFSET(200, 0), 64, 64, 90);
+}
+
+static int
+bench_rotate_check(void)
+{
+    return BENCH_PIXEL(500, 0) == BENCH_PIXEL(200, 63) &&
+        BENCH_PIXEL(563, 0) == BENCH_PIXEL(200, 0);
+}
+
+static void
+bench_vector(int i)
+{
+    gp_declare_vector(0);
+    gp_set_raster_operation(0xF0);
+    gp_set_solid_pattern(0x12345678);
+    gp_set_strides(BENCH_PITCH, BENCH_PITCH);
+    gp_line_from_endpoints(0, 600, 200, 663, 240, 1);
+}
+
+static int
+bench_vector_check(void)
+{
+    return BENCH_PIXEL(600, 200) == 0x12345678 &&
+        BENCH_PIXEL(663, 240) == 0x12345678;
+}
+
+static const BENCH_PRIMITIVE bench_primitives[] = {
+    {"solid fill 64x64", 64 * 64, bench_solid_fill, bench_solid_fill_check},
+    {"mono pattern 64x64", 64 * 64, bench_mono_pattern,
+     bench_mono_pattern_check},
+    {"screen copy 64x64", 64 * 64, bench_copy, bench_copy_check},
+    {"upload 64x64", 64 * 64, bench_upload, bench_upload_check},
+    {"mono text 64x64", 64 * 64, bench_text, bench_text_check},
+    {"blend mask 64x64", 64 * 64, bench_blend, bench_blend_check},
+    {"rotate 90 64x64", 64 * 64, bench_rotate, bench_rotate_check},
+    {"vector 64", 64, bench_vector, bench_vector_check},
+};
+
+/*---------------------------------------------------------------------------
+ * bench_run
+ *
+ * This routine issues a primitive 'count' times and returns the elapsed
+ * time in microseconds, including the time the emulator takes to execute
+ * the commands.
+ *-------------------------------------------------------------------------*/
+
+static double
+bench_run(const BENCH_PRIMITIVE * prim, int count)
+{
+    struct timespec start, end;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < count; i++)
+        prim->run(i);
+    gp_wait_until_idle();
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (end.tv_sec - start.tv_sec) * 1e6 +
+        (end.tv_nsec - start.tv_nsec) / 1e3;
+}
+
+int
+main(int argc, char **argv)
+{
+    GP_EMU_STATS stats;
+    unsigned int i, n;
+    int count = argc > 1 ? atoi(argv[1]) : 1000;
+    int failed = 0;
+    double decode, render;
+
+    if (count <= 0) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 2;
+    }
+
+    for (i = 0; i < sizeof(bench_host); i++)
+        bench_host[i] = (unsigned char) (i * 7);
+    for (i = 0; i < sizeof(bench_mono); i++)
+        bench_mono[i] = 0xAA;
+
+    printf("%-20s %10s %10s %10s %8s %10s\n", "primitive", "build us",
+           "total us", "Mpix/s", "packets", "host B");
+
+    for (n = 0; n < sizeof(bench_primitives) / sizeof(*bench_primitives); n++) {
+        const BENCH_PRIMITIVE *prim = &bench_primitives[n];
+
+        /* Building the commands alone, which is what the driver pays */
+
+        if (gp_emu_init(BENCH_FB_SIZE, BENCH_CMD_OFFSET, BENCH_CMD_SIZE,
+                        CIMGP_EMU_DECODE_ONLY) != CIM_STATUS_OK) {
+            fprintf(stderr, "gp_emu_init failed\n");
+            return 1;
+        }
+        gp_set_bpp(32);
+        decode = bench_run(prim, count);
+
+        /* Then with the emulator rendering them as well */
+
+        if (gp_emu_init(BENCH_FB_SIZE, BENCH_CMD_OFFSET, BENCH_CMD_SIZE, 0)
+            != CIM_STATUS_OK) {
+            fprintf(stderr, "gp_emu_init failed\n");
+            return 1;
+        }
+        gp_set_bpp(32);
+
+        /* Seed the areas that the copies read from */
+
+        bench_solid_fill(0);
+        bench_upload(0);
+        memset(cim_fb_ptr + BENCH_SCRATCH, 0xFF, 64 * 64);
+        gp_wait_until_idle();
+        gp_emu_reset_stats();
+
+        render = bench_run(prim, count);
+        gp_emu_get_stats(&stats);
+
+        printf("%-20s %10.3f %10.3f %10.2f %8.2f %10.1f",
+               prim->name, decode / count, render / count,
+               (prim->pixels * (double) count) / render,
+               (double) (stats.blts + stats.vectors + stats.lut_loads +
+                         stats.data_loads) / count,
+               (double) stats.host_bytes / count);
+
+        if (stats.errors || !prim->check()) {
+            printf("  FAILED (%lu errors)", stats.errors);
+            failed = 1;
+        }
+        printf("\n");
+    }
+
+    gp_emu_shutdown();
+
+    return failed;
+}
@@ -104,14 +104,17 @@ GXInitEXAMemory(ScrnInfoPtr pScrni, unsigned int *offset, unsigned int *avail)
         pGeode->exaBfrOffset = *offset;
         *offset += pGeode->exaBfrOffset;
         *avail -= pGeode->exaBfrOffset;
+        GeodeMemSetUsed(pGeode, GEODE_MEM_SCRATCH, pGeode->exaBfrSz);
     }
+    else if (pGeode->exaBfrSz > 0)
+        GeodeMemFailed(pGeode, GEODE_MEM_SCRATCH);
 }
 
 static void
 GXInitXAAMemory(ScrnInfoPtr pScrni, unsigned int *offset, unsigned int *avail)
 {
     GeodePtr pGeode = GEODEPTR(pScrni);
-    unsigned int size, i, pitch;
+    unsigned int size, i, pitch, used = 0;
 
     /* XXX - FIXME - What if we are out of room?  Then what? */
     /* For now, we NULL them all out.                        */
@@ -124,10 +127,13 @@ GXInitXAAMemory(ScrnInfoPtr pScrni, unsigned int *offset, unsigned int *avail)
                 *offset += pGeode->displayPitch;
                 *avail -= pGeode->displayPitch;
             }
+
+            used += size;
         }
         else {
             xf86DrvMsg(pScrni->scrnIndex, X_ERROR,
                        "Not enough memory for image write buffers.\n");
+            GeodeMemFailed(pGeode, GEODE_MEM_SCRATCH);
 
             for (i = 0; i < pGeode->NoOfImgBuffers; i++)
                 pGeode->AccelImageWriteBuffers[i] = NULL;
@@ -144,15 +150,33 @@ GXInitXAAMemory(ScrnInfoPtr pScrni, unsigned int *offset, unsigned int *avail)
                 *offset += pitch;
                 *avail -= pitch;
             }
+
+            used += size;
         }
         else {
             xf86DrvMsg(pScrni->scrnIndex, X_ERROR,
                        "Not enough memory for color expansion buffers.\n");
+            GeodeMemFailed(pGeode, GEODE_MEM_SCRATCH);
 
             for (i = 0; i < pGeode->NoOfImgBuffers; i++)
                 pGeode->AccelColorExpandBuffers[i] = NULL;
         }
     }
+
+    GeodeMemSetUsed(pGeode, GEODE_MEM_SCRATCH, used);
+}
+
+/* Write what each owner of video memory holds now and at its peak, and
+   how many of its allocations failed, to the log */
+
+static void
+GXDumpVideoMem(ScrnInfoPtr pScrni)
+{
+    GeodePtr pGeode = GEODEPTR(pScrni);
+
+    xf86DrvMsg(pScrni->scrnIndex, X_INFO, "GX video memory: 0x%x bytes\n",
+               pGeode->FBAvail);
+    GeodeMemDumpStats(pScrni);
 }
 
 static Bool
@@ -184,6 +208,13 @@ GXAllocateMemory(ScreenPtr pScrn, ScrnInfoPtr pScrni, int rotate)
     fbavail -= pGeode->displaySize;
     fboffset += pGeode->displaySize;
 
+    GeodeMemSetUsed(pGeode, GEODE_MEM_DISPLAY, pGeode->displaySize);
+    GeodeMemSetUsed(pGeode, GEODE_MEM_COMPRESSION, 0);
+    GeodeMemSetUsed(pGeode, GEODE_MEM_CURSOR, 0);
+    GeodeMemSetUsed(pGeode, GEODE_MEM_SCRATCH, 0);
+    GeodeMemSetUsed(pGeode, GEODE_MEM_SHADOW, 0);
+    GeodeMemSetUsed(pGeode, GEODE_MEM_EXA, 0);
+
     if (pGeode->tryCompression) {
         size = pScrni->virtualY * GX_CB_PITCH;
 
@@ -194,11 +225,13 @@ GXAllocateMemory(ScreenPtr pScrn, ScrnInfoPtr pScrni, int rotate)
             fbavail -= size;
 
             pGeode->Compression = TRUE;
+            GeodeMemSetUsed(pGeode, GEODE_MEM_COMPRESSION, size);
         }
         else {
             xf86DrvMsg(pScrni->scrnIndex, X_ERROR,
                        "Not enough memory for compression\n");
             pGeode->Compression = FALSE;
+            GeodeMemFailed(pGeode, GEODE_MEM_COMPRESSION);
         }
     }
 
@@ -209,11 +242,13 @@ GXAllocateMemory(ScreenPtr pScrn, ScrnInfoPtr pScrni, int rotate)
             fboffset += 1024;
             fbavail -= 1024;
             pGeode->HWCursor = TRUE;
+            GeodeMemSetUsed(pGeode, GEODE_MEM_CURSOR, 1024);
         }
         else {
             xf86DrvMsg(pScrni->scrnIndex, X_ERROR,
                        "Not enough memory for the hardware cursor\n");
             pGeode->HWCursor = FALSE;
+            GeodeMemFailed(pGeode, GEODE_MEM_CURSOR);
         }
     }
 
@@ -238,10 +273,12 @@ GXAllocateMemory(ScreenPtr pScrn, ScrnInfoPtr pScrni, int rotate)
 
             fboffset += size;
             fbavail -= size;
+            GeodeMemSetUsed(pGeode, GEODE_MEM_SHADOW, size);
         }
         else {
             xf86DrvMsg(pScrni->scrnIndex, X_ERROR,
                        "Not enough memory for the shadow framebuffer\n");
+            GeodeMemFailed(pGeode, GEODE_MEM_SHADOW);
             ret = FALSE;
         }
     }
@@ -257,6 +294,7 @@ GXAllocateMemory(ScreenPtr pScrn, ScrnInfoPtr pScrni, int rotate)
 
             pExa->offScreenBase = fboffset;
             pExa->memorySize = fboffset + fbavail;
+            GeodeMemSetUsed(pGeode, GEODE_MEM_EXA, fbavail);
         }
 
         if (!pGeode->useEXA) {
@@ -303,6 +341,10 @@ GXAllocateMemory(ScreenPtr pScrn, ScrnInfoPtr pScrni, int rotate)
 #endif
         }
     }
+
+    /* Show the memory map for diagnostic purposes */
+    GXDumpVideoMem(pScrni);
+
     return ret;
 }
 
@@ -1014,6 +1056,8 @@ GXCloseScreen(CLOSE_SCREEN_ARGS_DECL)
     if (pScrni->vtSema)
         GXLeaveGraphics(pScrni);
 
+    GXDumpVideoMem(pScrni);
+
 #ifdef XF86XAA
     if (pGeode->AccelInfoRec)
         XAADestroyInfoRec(pGeode->AccelInfoRec);
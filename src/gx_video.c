@@ -96,6 +96,7 @@ void GXResetVideo(ScrnInfoPtr pScrni);
 static XF86VideoAdaptorPtr GXSetupImageVideo(ScreenPtr);
 static void GXInitOffscreenImages(ScreenPtr);
 static void GXStopVideo(ScrnInfoPtr, pointer, Bool);
+static void GXFreeMemory(ScrnInfoPtr, void *);
 static int GXSetPortAttribute(ScrnInfoPtr, Atom, INT32, pointer);
 static int GXGetPortAttribute(ScrnInfoPtr, Atom, INT32 *, pointer);
 static void GXQueryBestSize(ScrnInfoPtr, Bool,
@@ -236,7 +237,7 @@ static XF86AttributeRec Attributes[NUM_ATTRIBUTES] = {
     {XvSettable | XvGettable, 0, 1, "XV_COLORKEYMODE"}
 };
 
-#define NUM_IMAGES 8
+#define NUM_IMAGES 10
 
 static XF86ImageRec Images[NUM_IMAGES] = {
     XVIMAGE_UYVY,
@@ -246,6 +247,8 @@ static XF86ImageRec Images[NUM_IMAGES] = {
     XVIMAGE_Y800,
     XVIMAGE_I420,
     XVIMAGE_YV12,
+    XVIMAGE_NV12,
+    XVIMAGE_NV21,
     XVIMAGE_RGB565
 };
 
@@ -480,14 +483,7 @@ GXStopVideo(ScrnInfoPtr pScrni, pointer data, Bool exit)
         }
 
         if (pPriv->area) {
-#ifdef XF86EXA
-            if (pGeode->useEXA)
-                exaOffscreenFree(pScrni->pScreen, pPriv->area);
-#endif
-
-            if (!pGeode->useEXA)
-                xf86FreeOffscreenArea(pPriv->area);
-
+            GXFreeMemory(pScrni, pPriv->area);
             pPriv->area = NULL;
         }
 
@@ -693,11 +689,38 @@ GXVideoSave(ScreenPtr pScreen, ExaOffscreenArea * area)
     ScrnInfoPtr pScrni = xf86ScreenToScrn(pScreen);
     GeodePortPrivRec *pPriv = GET_PORT_PRIVATE(pScrni);
 
-    if (area == pPriv->area)
+    if (area == pPriv->area) {
+        GeodeMemUsed(GEODEPTR(pScrni), GEODE_MEM_VIDEO, -area->size);
         pPriv->area = NULL;
+    }
 }
 #endif
 
+/* Give back the memory from GXAllocateMemory() */
+
+static void
+GXFreeMemory(ScrnInfoPtr pScrni, void *mem)
+{
+    GeodeRec *pGeode = GEODEPTR(pScrni);
+
+#if XF86EXA
+    if (pGeode->useEXA) {
+        ExaOffscreenArea *area = mem;
+
+        GeodeMemUsed(pGeode, GEODE_MEM_VIDEO, -area->size);
+        exaOffscreenFree(pScrni->pScreen, area);
+    }
+#endif
+
+    if (!pGeode->useEXA) {
+        FBAreaPtr area = mem;
+
+        GeodeMemUsed(pGeode, GEODE_MEM_VIDEO,
+                     -(area->box.y2 - area->box.y1) * pGeode->Pitch);
+        xf86FreeOffscreenArea(area);
+    }
+}
+
 static int
 GXAllocateMemory(ScrnInfoPtr pScrni, void **memp, int numlines)
 {
@@ -715,14 +738,20 @@ GXAllocateMemory(ScrnInfoPtr pScrni, void **memp, int numlines)
             if (area->size >= size)
                 return area->offset;
 
-            exaOffscreenFree(pScrni->pScreen, area);
+            GXFreeMemory(pScrni, area);
         }
 
         area = exaOffscreenAlloc(pScrni->pScreen, size, 16,
                                  TRUE, GXVideoSave, NULL);
         *memp = area;
 
-        return area == NULL ? 0 : area->offset;
+        if (area == NULL) {
+            GeodeMemFailed(pGeode, GEODE_MEM_VIDEO);
+            return 0;
+        }
+
+        GeodeMemUsed(pGeode, GEODE_MEM_VIDEO, area->size);
+        return area->offset;
     }
 #endif
 
@@ -731,13 +760,19 @@ GXAllocateMemory(ScrnInfoPtr pScrni, void **memp, int numlines)
         FBAreaPtr new_area;
 
         if (area) {
-            if ((area->box.y2 - area->box.y1) >= numlines)
+            int lines = area->box.y2 - area->box.y1;
+
+            if (lines >= numlines)
                 return (area->box.y1 * pGeode->Pitch);
 
-            if (xf86ResizeOffscreenArea(area, pGeode->displayWidth, numlines))
+            if (xf86ResizeOffscreenArea(area, pGeode->displayWidth, numlines)) {
+                GeodeMemUsed(pGeode, GEODE_MEM_VIDEO,
+                             (numlines - lines) * pGeode->Pitch);
                 return (area->box.y1 * pGeode->Pitch);
+            }
 
-            xf86FreeOffscreenArea(area);
+            GXFreeMemory(pScrni, area);
+            *memp = NULL;
         }
 
         new_area = xf86AllocateOffscreenArea(pScrn, pGeode->displayWidth,
@@ -754,14 +789,23 @@ GXAllocateMemory(ScrnInfoPtr pScrni, void **memp, int numlines)
                 xf86DrvMsg(pScrni->scrnIndex, X_ERROR,
                            "No room - how sad %x, %x, %x, %x\n", max_w,
                            pGeode->displayWidth, max_h, numlines);
+                GeodeMemFailed(pGeode, GEODE_MEM_VIDEO);
                 return 0;
             }
 
             xf86PurgeUnlockedOffscreenAreas(pScrn);
             new_area = xf86AllocateOffscreenArea(pScrn, pGeode->displayWidth,
                                                  numlines, 0, NULL, NULL, NULL);
+
+            if (!new_area) {
+                GeodeMemFailed(pGeode, GEODE_MEM_VIDEO);
+                return 0;
+            }
         }
 
+        *memp = new_area;
+        GeodeMemUsed(pGeode, GEODE_MEM_VIDEO, numlines * pGeode->Pitch);
+
         return (new_area->box.y1 * pGeode->Pitch);
     }
 
@@ -864,7 +908,8 @@ GXSetVideoPosition(int x, int y, int width, int height,
 
     GFX(set_video_window(x, ystart, xend - x, yend - ystart));
 
-    if ((id == FOURCC_Y800) || (id == FOURCC_I420) || (id == FOURCC_YV12)) {
+    if ((id == FOURCC_Y800) || (id == FOURCC_I420) || (id == FOURCC_YV12) ||
+        (id == FOURCC_NV12) || (id == FOURCC_NV21)) {
         GFX(set_video_yuv_offsets(offset + y_extra,
                                   offset + d3offset + uv_extra,
                                   offset + d2offset + uv_extra));
@@ -931,6 +976,8 @@ GXDisplayVideo(ScrnInfoPtr pScrni,
     case FOURCC_Y800:          /* Y800 - greyscale - we munge it! */
     case FOURCC_YV12:          /* YV12 */
     case FOURCC_I420:          /* I420 */
+    case FOURCC_NV12:          /* NV12 - split into U and V on upload */
+    case FOURCC_NV21:          /* NV21 */
         GFX(set_video_format(VIDEO_FORMAT_Y0Y1Y2Y3));
         GFX(set_video_size(width, height));
         GFX(set_video_yuv_pitch(dstPitch, dstPitch2));
@@ -1096,6 +1143,8 @@ GXPutImage(ScrnInfoPtr pScrni,
         switch (id) {
         case FOURCC_YV12:
         case FOURCC_I420:
+        case FOURCC_NV12:
+        case FOURCC_NV21:
             srcPitch = (width + 3) & ~3;        /* of luma */
             dstPitch = (width + 31) & ~31;
 
@@ -1142,6 +1191,8 @@ GXPutImage(ScrnInfoPtr pScrni,
         switch (id) {
         case FOURCC_YV12:
         case FOURCC_I420:
+        case FOURCC_NV12:
+        case FOURCC_NV21:
         {
             int tmp;
 
@@ -1154,7 +1205,12 @@ GXPutImage(ScrnInfoPtr pScrni,
                 offset += (new_h >> 1) * pGeode->Pitch;
 #endif
             dst_start = pGeode->FBBase + offset + left;
-            tmp = ((top >> 1) * srcPitch2) + (left >> 1);
+            /* The NV chroma plane has the luma pitch, and a pair of bytes
+             * for every two pixels */
+            if (id == FOURCC_NV12 || id == FOURCC_NV21)
+                tmp = ((top >> 1) * srcPitch) + left;
+            else
+                tmp = ((top >> 1) * srcPitch2) + (left >> 1);
             s2offset += tmp;
             s3offset += tmp;
             if (id == FOURCC_I420) {
@@ -1209,6 +1265,21 @@ GXPutImage(ScrnInfoPtr pScrni,
         GXCopyData420(buf + s3offset, dst_start + d3offset, srcPitch2,
                       dstPitch2, nlines >> 1, npixels >> 1);
         break;
+    case FOURCC_NV12:
+    case FOURCC_NV21:
+        GXCopyData420(buf + s1offset, dst_start, srcPitch, dstPitch, nlines,
+                      npixels);
+
+        /* U is read from d3offset and V from d2offset */
+        if (id == FOURCC_NV12)
+            GeodeSplitChroma(buf + s2offset, dst_start + d3offset,
+                             dst_start + d2offset, srcPitch, dstPitch2,
+                             nlines >> 1, npixels >> 1);
+        else
+            GeodeSplitChroma(buf + s2offset, dst_start + d2offset,
+                             dst_start + d3offset, srcPitch, dstPitch2,
+                             nlines >> 1, npixels >> 1);
+        break;
     case FOURCC_UYVY:
     case FOURCC_YUY2:
     case FOURCC_RGB565:
@@ -1303,6 +1374,20 @@ GeodeQueryImageAttributes(ScrnInfoPtr pScrni,
         if (offsets)
             offsets[2] = size;
 
+        size += tmp;
+        break;
+    case FOURCC_NV12:
+    case FOURCC_NV21:
+        *h = (*h + 1) & ~1;
+        size = (*w + 3) & ~3;
+        if (pitches)
+            pitches[0] = pitches[1] = size;
+
+        tmp = size * (*h >> 1);
+        size *= *h;
+        if (offsets)
+            offsets[1] = size;
+
         size += tmp;
         break;
     case FOURCC_UYVY:
@@ -1356,13 +1441,7 @@ GXBlockHandler(BLOCKHANDLER_ARGS_DECL)
             if (pPriv->freeTime < currentTime.milliseconds) {
 
                 if (pPriv->area) {
-#ifdef XF86EXA
-                    if (pGeode->useEXA)
-                        exaOffscreenFree(pScrn, pPriv->area);
-#endif
-                    if (!pGeode->useEXA)
-                        xf86FreeOffscreenArea(pPriv->area);
-
+                    GXFreeMemory(pScrni, pPriv->area);
                     pPriv->area = NULL;
                 }
 
@@ -1464,7 +1543,7 @@ GXFreeSurface(XF86SurfacePtr surface)
     if (pPriv->isOn)
         GXStopSurface(surface);
 
-    xf86FreeOffscreenArea(pPriv->area);
+    GXFreeMemory(surface->pScrn, pPriv->area);
     free(surface->pitches);
     free(surface->offsets);
     free(surface->devPrivate.ptr);
@@ -310,17 +310,14 @@ lx_crtc_commit(xf86CrtcPtr crtc)
 {
     LXCrtcPrivatePtr lx_crtc = crtc->driver_private;
     ScrnInfoPtr pScrni = crtc->scrn;
-    GeodeRec *pGeode = GEODEPTR(pScrni);
 
     /* Turn back on the sreen */
     crtc->funcs->dpms(crtc, DPMSModeOn);
 
-    /* Turn on compression */
+    /* Re-plan the compression buffer for the new mode.  This also
+     * configures compression and turns it back on. */
 
-    if (pGeode->Compression) {
-        vg_configure_compression(&(pGeode->CBData));
-        vg_set_compression_enable(1);
-    }
+    LXUpdateOffscreen(pScrni);
 
     /* Load the cursor */
     if (crtc->scrn->pScreen != NULL) {
@@ -387,7 +384,9 @@ lx_create_bo_pixmap(ScreenPtr pScreen,
                     int width, int height,
                     int depth, int bpp, int pitch, pointer pPixData)
 {
+    GeodeRec *pGeode = GEODEPTR(xf86ScreenToScrn(pScreen));
     PixmapPtr pixmap;
+    Bool mixed = GEODE_EXA_MIXED(pGeode) && !pGeode->NoAccel;
 
 #if XORG_VERSION_CURRENT >= XORG_VERSION_NUMERIC(1,5,0,0,0)
     pixmap = (*pScreen->CreatePixmap) (pScreen, 0, 0, depth, 0);
@@ -397,8 +396,16 @@ lx_create_bo_pixmap(ScreenPtr pScreen,
 
     if (!pixmap)
         return NULL;
+
+    /* With mixed pixmaps, EXA would keep a pixmap that is given its data
+     * in system memory, so the video memory is attached afterwards */
+
     if (!(*pScreen->ModifyPixmapHeader) (pixmap, width, height,
-                                         depth, bpp, pitch, pPixData)) {
+                                         depth, bpp, pitch,
+                                         mixed ? NULL : pPixData) ||
+        (mixed && !LXExaAttachPixmap(pixmap,
+                                     (unsigned char *) pPixData -
+                                     pGeode->FBBase, pitch))) {
         /* ModifyPixmapHeader failed, so we can't use it as scratch pixmap
          */
         (*pScreen->DestroyPixmap) (pixmap);
@@ -428,14 +435,14 @@ LXAllocShadow(ScrnInfoPtr pScrni, int size)
 
     if (pGeode->shadowArea) {
         if (pGeode->shadowArea->size != size) {
-            exaOffscreenFree(pScrni->pScreen, pGeode->shadowArea);
+            LXFreeVideoMem(pScrni, pGeode->shadowArea);
             pGeode->shadowArea = NULL;
         }
     }
 
     if (pGeode->shadowArea == NULL) {
-        pGeode->shadowArea =
-            exaOffscreenAlloc(pScrni->pScreen, size, 4, TRUE, NULL, NULL);
+        pGeode->shadowArea = LXAllocVideoMem(pScrni, size, 4,
+                                             GEODE_MEM_SHADOW);
 
         if (pGeode->shadowArea == NULL)
             return FALSE;
@@ -506,7 +513,7 @@ lx_crtc_shadow_destroy(xf86CrtcPtr crtc, PixmapPtr rpixmap, void *data)
     if (data) {
         gp_wait_until_idle();
         if (pGeode->shadowArea != NULL) {
-            exaOffscreenFree(pScrni->pScreen, pGeode->shadowArea);
+            LXFreeVideoMem(pScrni, pGeode->shadowArea);
             pGeode->shadowArea = NULL;
         }
     }
@@ -456,6 +456,9 @@ LXPreInit(ScrnInfoPtr pScrni, int flags)
     if (pGeode->exaBfrSz <= 0)
         pGeode->exaBfrSz = 0;
 
+    pGeode->tryMixedPixmaps = xf86ReturnOptValBool(GeodeOptions,
+                                                   LX_OPTION_EXA_MIXED, FALSE);
+
     if (pGeode->Output & OUTPUT_PANEL) {
         if (xf86ReturnOptValBool(GeodeOptions, LX_OPTION_NOPANEL, FALSE))
             pGeode->Output &= ~OUTPUT_PANEL;
@@ -725,7 +728,16 @@ LXCloseScreen(CLOSE_SCREEN_ARGS_DECL)
     if (pScrni->vtSema)
         LXLeaveGraphics(pScrni);
 
+    LXDumpVideoMem(pScrni);
+
+    if (pGeode->compressionArea) {
+        LXFreeVideoMem(pScrni, pGeode->compressionArea);
+        pGeode->compressionArea = NULL;
+        pGeode->Compression = FALSE;
+    }
+
     if (pGeode->pExa) {
+        LXExaDumpFallbacks(pScrni);
         exaDriverFini(pScrn);
         free(pGeode->pExa);
         pGeode->pExa = NULL;
@@ -838,6 +850,36 @@ LXLoadPalette(ScrnInfoPtr pScrni,
     }
 }
 
+static Bool
+LXCreateScreenResources(ScreenPtr pScrn)
+{
+    ScrnInfoPtr pScrni = xf86ScreenToScrn(pScrn);
+    GeodeRec *pGeode = GEODEPTR(pScrni);
+    PixmapPtr pPixmap;
+
+    pScrn->CreateScreenResources = pGeode->CreateScreenResources;
+    if (!(*pScrn->CreateScreenResources) (pScrn))
+        return FALSE;
+
+    /* The first mode set came before EXA was up, so the compression
+     * buffer is only allocated now */
+    LXUpdateOffscreen(pScrni);
+
+    if (!GEODE_EXA_MIXED(pGeode))
+        return TRUE;
+
+    /* Point the screen pixmap at the framebuffer, through EXA unless it
+     * failed to start */
+
+    pPixmap = (*pScrn->GetScreenPixmap) (pScrn);
+
+    if (!pGeode->NoAccel)
+        return LXExaAttachPixmap(pPixmap, pScrni->fbOffset, pGeode->Pitch);
+
+    return (*pScrn->ModifyPixmapHeader) (pPixmap, -1, -1, -1, -1, -1,
+                                         pGeode->FBBase + pScrni->fbOffset);
+}
+
 static Bool
 LXScreenInit(SCREEN_INIT_ARGS_DECL)
 {
@@ -870,6 +912,13 @@ LXScreenInit(SCREEN_INIT_ARGS_DECL)
             pGeode->pExa->pixmapOffsetAlign = 32;
             pGeode->pExa->pixmapPitchAlign = 32;
             pGeode->pExa->flags = EXA_OFFSCREEN_PIXMAPS;
+
+#ifdef EXA_MIXED_PIXMAPS
+            /* Pixmaps start out in system memory, and are only given
+             * video memory by the driver once the GP draws with them */
+            if (pGeode->tryMixedPixmaps)
+                pGeode->pExa->flags |= EXA_HANDLES_PIXMAPS | EXA_MIXED_PIXMAPS;
+#endif
             pGeode->pExa->maxX = LX_MAX_WIDTH - 1;
             pGeode->pExa->maxY = LX_MAX_HEIGHT - 1;
         }
@@ -924,7 +973,11 @@ LXScreenInit(SCREEN_INIT_ARGS_DECL)
 
     dwidth = pGeode->Pitch / ((pScrni->bitsPerPixel + 7) / 8);
 
-    ret = fbScreenInit(pScrn, pGeode->FBBase,
+    /* With mixed pixmaps the screen pixmap is created empty, and the
+     * framebuffer is attached in LXCreateScreenResources() */
+
+    ret = fbScreenInit(pScrn,
+                       GEODE_EXA_MIXED(pGeode) ? NULL : pGeode->FBBase,
                        pScrni->virtualX, pScrni->virtualY,
                        pScrni->xDpi, pScrni->yDpi, dwidth,
                        pScrni->bitsPerPixel);
@@ -993,6 +1046,9 @@ LXScreenInit(SCREEN_INIT_ARGS_DECL)
 
     pGeode->CloseScreen = pScrn->CloseScreen;
     pScrn->CloseScreen = LXCloseScreen;
+
+    pGeode->CreateScreenResources = pScrn->CreateScreenResources;
+    pScrn->CreateScreenResources = LXCreateScreenResources;
     pScrn->SaveScreen = LXSaveScreen;
 
     if (!xf86CrtcScreenInit(pScrn)) {
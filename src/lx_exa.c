@@ -36,8 +36,12 @@
 #include "config.h"
 #endif
 
+#include <stdlib.h>             /* malloc() */
+#include <string.h>             /* memset() */
+
 #include "xf86.h"
 #include "exa.h"
+#include "mi.h"
 
 #include "geode.h"
 #include "cim_defs.h"
@@ -50,17 +54,118 @@
 
 #define GEODE_TRACE_FALL 0
 
+/* Every composite fallback is counted by its reason, by operation and by
+ * the formats involved, see LXExaDumpFallbacks().  GEODE_FALLBACK() returns
+ * FALSE from lx_can_composite() and notes the reason, which is one of the
+ * LX_FB_ indices below, for lx_check_composite() to count. */
+
 #if GEODE_TRACE_FALL
-#define GEODE_FALLBACK(x)               \
+#define GEODE_FALLBACK(reason, x)       \
 do {                                    \
 	ErrorF("%s: ", __FUNCTION__);   \
 	ErrorF x;                       \
-	return FALSE;                   \
+	return lx_fallback(reason);     \
 } while (0)
 #else
-#define GEODE_FALLBACK(x) return FALSE
+#define GEODE_FALLBACK(reason, x)       \
+do {                                    \
+	return lx_fallback(reason);     \
+} while (0)
 #endif
 
+enum {
+    LX_FB_OP,
+    LX_FB_SOURCE_PICT_PASSES,
+    LX_FB_GRADIENT_TRANSFORM,
+    LX_FB_GRADIENT_DIRECTION,
+    LX_FB_GRADIENT_SRC,
+    LX_FB_MASK_PICT,
+    LX_FB_ADD_MASK,
+    LX_FB_PASSES_BUFFER,
+    LX_FB_PASSES_WIDTH,
+    LX_FB_FILTER,
+    LX_FB_MASK_TRANSFORM,
+    LX_FB_TRANSFORM,
+    LX_FB_SCALE_OP,
+    LX_FB_SCALE_BUFFER,
+    LX_FB_SCALE_BILINEAR,
+    LX_FB_PASSES_ROTATE,
+    LX_FB_A8_DST,
+    LX_FB_A8_SRC_MASK,
+    LX_FB_A8_SRC_BPP,
+    LX_FB_A8_SRC_OP,
+    LX_FB_MASK_BPP,
+    LX_FB_MASK_FORMAT,
+    LX_FB_MASK_SRC_SIZE,
+    LX_FB_MASK_SRC_REPEAT,
+    LX_FB_SRC_FORMAT,
+    LX_FB_DST_FORMAT,
+    LX_FB_SRC_ALPHA,
+    LX_FB_DST_ALPHA,
+    LX_FB_ALPHABITS,
+    LX_FB_ROTATE_CONVERT,
+    LX_FALLBACK_REASONS
+};
+
+static const char *lx_fallback_names[LX_FALLBACK_REASONS] = {
+    [LX_FB_OP] = "unsupported operation",
+    [LX_FB_SOURCE_PICT_PASSES] = "solid or gradient source with passes",
+    [LX_FB_GRADIENT_TRANSFORM] = "gradient transform",
+    [LX_FB_GRADIENT_DIRECTION] = "gradient not horizontal or vertical",
+    [LX_FB_GRADIENT_SRC] = "gradient source",
+    [LX_FB_MASK_PICT] = "solid or gradient mask",
+    [LX_FB_ADD_MASK] = "PictOpAdd with mask",
+    [LX_FB_PASSES_BUFFER] = "multipass without off-screen buffer",
+    [LX_FB_PASSES_WIDTH] = "multipass destination too wide",
+    [LX_FB_FILTER] = "unsupported filter",
+    [LX_FB_MASK_TRANSFORM] = "mask transform",
+    [LX_FB_TRANSFORM] = "non-trivial transform",
+    [LX_FB_SCALE_OP] = "scaling with mask or passes",
+    [LX_FB_SCALE_BUFFER] = "scaling without off-screen buffer",
+    [LX_FB_SCALE_BILINEAR] = "bilinear scaling below 32bpp",
+    [LX_FB_PASSES_ROTATE] = "multipass rotation",
+    [LX_FB_A8_DST] = "PICT_a8 destination",
+    [LX_FB_A8_SRC_MASK] = "PICT_a8 source with mask",
+    [LX_FB_A8_SRC_BPP] = "PICT_a8 source below 16bpp",
+    [LX_FB_A8_SRC_OP] = "PICT_a8 source operation",
+    [LX_FB_MASK_BPP] = "mask blending below 16bpp",
+    [LX_FB_MASK_FORMAT] = "mask format",
+    [LX_FB_MASK_SRC_SIZE] = "mask with source larger than 1x1",
+    [LX_FB_MASK_SRC_REPEAT] = "mask with non repeating source",
+    [LX_FB_SRC_FORMAT] = "source format",
+    [LX_FB_DST_FORMAT] = "destination format",
+    [LX_FB_SRC_ALPHA] = "source alpha needed",
+    [LX_FB_DST_ALPHA] = "destination alpha needed",
+    [LX_FB_ALPHABITS] = "destination alpha without source alpha",
+    [LX_FB_ROTATE_CONVERT] = "rotation with format conversion",
+};
+
+#define LX_FALLBACK_FORMATS 32
+
+static struct {
+    unsigned long checks;
+    unsigned long fallbacks;
+
+    unsigned long reasons[LX_FALLBACK_REASONS];
+
+    /* One more for the operations that aren't supported at all */
+    unsigned long ops[PictOpAdd + 2];
+
+    struct {
+        CARD32 src, msk, dst;
+        unsigned long count;
+    } formats[LX_FALLBACK_FORMATS];
+    unsigned long otherFormats;
+} lx_fallbacks;
+
+static int lx_fallback_last;
+
+/* Solid fills and copies are queued in the command buffer and the GP
+ * write pointer is only updated when this many bytes are outstanding,
+ * or at DoneSolid/DoneCopy and WaitMarker time */
+
+#define LX_CMD_BATCH_LIMIT (GP3_BLT_COMMAND_SIZE * 32)
+
 static const struct exa_format_t {
     int exa;
     int bpp;
@@ -78,7 +183,7 @@ static const struct exa_format_t {
     PICT_x1r5g5b5, 16, CIMGP_SOURCE_FMT_1_5_5_5, 0}, {
     PICT_x1b5g5r5, 16, CIMGP_SOURCE_FMT_15BPP_BGR, 0}, {
     PICT_r3g3b2, 8, CIMGP_SOURCE_FMT_3_3_2, 0}, {
-    PICT_a8, 32, CIMGP_SOURCE_FMT_8_8_8_8, 8}
+    PICT_a8, 8, CIMGP_SOURCE_FMT_3_3_2, 8}
 };
 
 /* This is a chunk of memory we use for scratch space */
@@ -87,6 +192,9 @@ static const struct exa_format_t {
 #define COMP_TYPE_ONEPASS 1
 #define COMP_TYPE_TWOPASS 3
 #define COMP_TYPE_ROTATE  5
+#define COMP_TYPE_SOLID   7
+#define COMP_TYPE_SCALE   9
+#define COMP_TYPE_GRADIENT 11
 
 static struct {
     int type;
@@ -97,19 +205,65 @@ static struct {
     unsigned int srcWidth, srcHeight;
 
     unsigned int srcColor;
+    unsigned int srcAlpha;
     int op;
     int repeat;
     int maskrepeat;
+    int solidMask;
+    int runStarted;
+    unsigned long runMarker;
     unsigned int fourBpp;
     unsigned int bufferOffset;
+    unsigned int bufferSize;
     struct exa_format_t *srcFormat;
     struct exa_format_t *dstFormat;
 
     int rotate;
+    int scale;
+    int bilinear;
     PictTransform *transform;
 
+    PictLinearGradient *gradient;
+    int gradientRepeat;
+    int gradientVertical;
+    CARD32 gradientHash;
+
 } exaScratch;
 
+/* The scratch buffer is split into slots that are used in turn by
+ * the bands of lx_do_composite_mask_two_pass() and lx_composite_scale(),
+ * so one band can be queued while the GP is still blending the previous
+ * one.  Each slot remembers the marker following the last blt that
+ * reads it. */
+
+#define LX_SCRATCH_SLOTS 2
+
+static struct {
+    int used;
+    unsigned long marker;
+} lx_scratch_slots[LX_SCRATCH_SLOTS];
+
+static int lx_scratch_next;
+
+/* Recently drawn gradient strips are kept in off-screen memory, so the
+ * same widget background drawn again doesn't have to be rendered by the
+ * CPU again.  The areas aren't locked, EXA can take them back when it
+ * needs the memory for pixmaps.  With mixed pixmaps the strips come from
+ * the offscreen list instead. */
+
+#define LX_GRADIENT_CACHE 8
+
+static struct lx_gradient {
+    ExaOffscreenArea *area;
+    GeodeMemPtr mem;
+    CARD32 hash;
+    int vertical;
+    int start;
+    int length;
+} lx_gradients[LX_GRADIENT_CACHE];
+
+static int lx_gradient_next;
+
 static const int SDfn[16] = {
     0x00, 0x88, 0x44, 0xCC, 0x22, 0xAA, 0x66, 0xEE,
     0x11, 0x99, 0x55, 0xDD, 0x33, 0xBB, 0x77, 0xFF
@@ -122,46 +276,195 @@ static const int SDfn_PM[16] = {
 
 /* These functions check to see if we can safely prefetch the memory
  * for the blt, or if we have to wait the previous blt to complete.
- * One function is for the fill, and the other is for the copy because
- * they have different requirements based on ROP
+ * The destinations of recent blts are kept in a small ring along with
+ * the command buffer marker that follows them.  A blt only needs the
+ * hazard flag if it reads (as source, or as destination through the
+ * ROP) an area that one of those still in-flight blts writes.  Entries
+ * are retired lazily - the GP read pointer is only checked when an
+ * overlap is found.  The CPU uses the same ring to wait for only the
+ * blts that write to an area it is about to read.
  */
 
-static int lx0 = -1, ly0 = -1, lx1 = -1, ly1 = -1;
+#define LX_HAZARD_ENTRIES 8
+
+static struct {
+    unsigned long start, end;   /* byte span, 0/0 for an unused entry */
+    unsigned int offset, pitch, bpp;
+    int x0, y0, x1, y1;
+    unsigned long marker;
+} lx_hazards[LX_HAZARD_ENTRIES];
+
+static int lx_hazard_next;
+
+/* Entries leave the ring before their blts are known to be complete,
+ * either when the ring is full or when a blt with the hazard flag drops
+ * them.  The barrier is the marker following the newest of them, and
+ * the CPU waits for it before it reads anything.  After a full ring, the
+ * next blt that reads video memory also takes the hazard flag until the
+ * barrier is reached. */
+
+static unsigned long lx_hazard_barrier;
+static int lx_hazard_barrier_set;
+static int lx_hazard_dropped;
+
+static void
+lx_hazard_reset(void)
+{
+    memset(lx_hazards, 0, sizeof(lx_hazards));
+}
 
 static int
-lx_fill_flags(int x0, int y0, int w, int h, int rop)
+lx_hazard_overlaps(int i, unsigned int offset, unsigned int pitch,
+                   unsigned int bpp, int x0, int y0, int w, int h)
 {
-    int x1 = x0 + w, y1 = y0 + h;
-    int n = ((rop ^ (rop >> 1)) & 0x55) == 0 || /* no dst */
-        x0 >= lx1 || y0 >= ly1 ||       /* rght/below */
-        x1 <= lx0 || y1 <= ly0 ?        /* left/above */
-        0 : CIMGP_BLTFLAGS_HAZARD;
+    unsigned long start = offset + (y0 * pitch) + (x0 * bpp);
+    unsigned long end = offset + ((y0 + h - 1) * pitch) + ((x0 + w) * bpp);
 
-    lx0 = x0;
-    ly0 = y0;
-    lx1 = x1;
-    ly1 = y1;
+    if (lx_hazards[i].start >= end || lx_hazards[i].end <= start)
+        return FALSE;
 
-    return n;
+    /* Within the same surface, compare the actual rectangles */
+
+    if (lx_hazards[i].offset == offset && lx_hazards[i].pitch == pitch &&
+        lx_hazards[i].bpp == bpp &&
+        (x0 >= lx_hazards[i].x1 || y0 >= lx_hazards[i].y1 ||
+         x0 + w <= lx_hazards[i].x0 || y0 + h <= lx_hazards[i].y0))
+        return FALSE;
+
+    return TRUE;
+}
+
+static int
+lx_hazard_check(unsigned int offset, unsigned int pitch, unsigned int bpp,
+                int x0, int y0, int w, int h)
+{
+    int i;
+
+    if (lx_hazard_dropped) {
+        if (!gp_test_command_marker(lx_hazard_barrier))
+            return CIMGP_BLTFLAGS_HAZARD;
+
+        lx_hazard_dropped = 0;
+        lx_hazard_barrier_set = 0;
+    }
+
+    for (i = 0; i < LX_HAZARD_ENTRIES; i++) {
+        if (!lx_hazard_overlaps(i, offset, pitch, bpp, x0, y0, w, h))
+            continue;
+
+        if (!gp_test_command_marker(lx_hazards[i].marker))
+            return CIMGP_BLTFLAGS_HAZARD;
+
+        lx_hazards[i].start = lx_hazards[i].end = 0;
+    }
+
+    return 0;
+}
+
+/* Wait for the queued blts that write to an area before the CPU reads
+ * it, rather than for the GP to go idle */
+
+static void
+lx_hazard_wait(unsigned int offset, unsigned int pitch, unsigned int bpp,
+               int x0, int y0, int w, int h)
+{
+    int i;
+
+    if (lx_hazard_barrier_set) {
+        gp_wait_command_marker(lx_hazard_barrier);
+        lx_hazard_barrier_set = 0;
+        lx_hazard_dropped = 0;
+    }
+
+    for (i = 0; i < LX_HAZARD_ENTRIES; i++) {
+        if (!lx_hazard_overlaps(i, offset, pitch, bpp, x0, y0, w, h))
+            continue;
+
+        gp_wait_command_marker(lx_hazards[i].marker);
+        lx_hazards[i].start = lx_hazards[i].end = 0;
+    }
+}
+
+/* Record the destination of a blt that was just queued.  A blt with the
+ * hazard flag waits for everything before it, so older entries can be
+ * dropped at that point.  When the ring is full the oldest entry is
+ * dropped rather than waited for, and left to the barrier. */
+
+static void
+lx_hazard_record(int flags, unsigned int offset, unsigned int pitch,
+                 unsigned int bpp, int x0, int y0, int w, int h)
+{
+    if (flags & CIMGP_BLTFLAGS_HAZARD) {
+        lx_hazard_reset();
+        lx_hazard_barrier = gp_get_command_marker();
+        lx_hazard_barrier_set = 1;
+        lx_hazard_dropped = 0;
+    }
+    else if (lx_hazards[lx_hazard_next].end > lx_hazards[lx_hazard_next].start) {
+        lx_hazard_barrier = lx_hazards[lx_hazard_next].marker;
+        lx_hazard_barrier_set = 1;
+        lx_hazard_dropped = 1;
+    }
+
+    lx_hazards[lx_hazard_next].start = offset + (y0 * pitch) + (x0 * bpp);
+    lx_hazards[lx_hazard_next].end =
+        offset + ((y0 + h - 1) * pitch) + ((x0 + w) * bpp);
+    lx_hazards[lx_hazard_next].offset = offset;
+    lx_hazards[lx_hazard_next].pitch = pitch;
+    lx_hazards[lx_hazard_next].bpp = bpp;
+    lx_hazards[lx_hazard_next].x0 = x0;
+    lx_hazards[lx_hazard_next].y0 = y0;
+    lx_hazards[lx_hazard_next].x1 = x0 + w;
+    lx_hazards[lx_hazard_next].y1 = y0 + h;
+    lx_hazards[lx_hazard_next].marker = gp_get_command_marker();
+
+    lx_hazard_next = (lx_hazard_next + 1) % LX_HAZARD_ENTRIES;
+}
+
+/* Composite operations write to scratch areas and sometimes the source
+ * as well as the destination, so they are recorded as touching all of
+ * video memory */
+
+static void
+lx_hazard_record_all(void)
+{
+    lx_hazard_reset();
+    lx_hazard_barrier_set = 0;
+    lx_hazard_dropped = 0;
+
+    lx_hazards[0].start = 0;
+    lx_hazards[0].end = ~0UL;
+    lx_hazards[0].marker = gp_get_command_marker();
+    lx_hazard_next = 1;
 }
 
 static int
-lx_copy_flags(int x0, int y0, int x1, int y1, int w, int h, int rop)
+lx_fill_flags(PixmapPtr pxMap, int x0, int y0, int w, int h, int rop)
 {
-    int x2 = x1 + w, y2 = y1 + h;
+    if (((rop ^ (rop >> 1)) & 0x55) == 0)       /* no dst */
+        return 0;
 
-    /* dst not hazzard and src not hazzard */
-    int n = (((rop ^ (rop >> 1)) & 0x55) == 0 ||
-             x1 >= lx1 || y1 >= ly1 ||
-             x2 <= lx0 || y2 <= ly0) &&
-        (((rop ^ (rop >> 2)) & 0x33) == 0 ||
-         x0 >= lx1 || y0 >= ly1 ||
-         x0 + w <= lx0 || y0 + h <= ly0) ? 0 : CIMGP_BLTFLAGS_HAZARD;
+    return lx_hazard_check(exaGetPixmapOffset(pxMap),
+                           exaGetPixmapPitch(pxMap),
+                           (pxMap->drawable.bitsPerPixel + 7) / 8,
+                           x0, y0, w, h);
+}
+
+static int
+lx_copy_flags(PixmapPtr pxDst, int x0, int y0, int x1, int y1, int w, int h,
+              int rop)
+{
+    int n = 0;
 
-    lx0 = x1;
-    ly0 = y1;
-    lx1 = x2;
-    ly1 = y2;
+    if (((rop ^ (rop >> 1)) & 0x55) != 0)      /* dst */
+        n = lx_hazard_check(exaGetPixmapOffset(pxDst),
+                            exaGetPixmapPitch(pxDst),
+                            (pxDst->drawable.bitsPerPixel + 7) / 8,
+                            x1, y1, w, h);
+
+    if (!n && ((rop ^ (rop >> 2)) & 0x33) != 0)        /* src */
+        n = lx_hazard_check(exaScratch.srcOffset, exaScratch.srcPitch,
+                            exaScratch.srcBpp, x0, y0, w, h);
 
     return n;
 }
@@ -286,7 +589,8 @@ lx_get_source_color(PixmapPtr pSrc, int srcFormat, int dstFormat)
      */
     /* FIXME: xserver-1.4 with a supposed fix for this is really old, so kill the stall? */
 
-    gp_wait_until_idle();
+    lx_hazard_wait(exaGetPixmapOffset(pSrc), exaGetPixmapPitch(pSrc),
+                   (pSrc->drawable.bitsPerPixel + 7) / 8, 0, 0, 1, 1);
     in = exaGetPixmapFirstPixel(pSrc);
 
     _GetRGBAFromPixel(in, &red, &blue, &green, &alpha, srcFormat);
@@ -324,9 +628,13 @@ lx_do_solid(PixmapPtr pxMap, int x1, int y1, int x2, int y2)
     int bpp = (pxMap->drawable.bitsPerPixel + 7) / 8;
     int pitch = exaGetPixmapPitch(pxMap);
     unsigned int offset = exaGetPixmapOffset(pxMap) + (pitch * y1) + (bpp * x1);
+    int flags = lx_fill_flags(pxMap, x1, y1, x2 - x1, y2 - y1, exaScratch.op);
 
-    gp_declare_blt(lx_fill_flags(x1, y1, x2 - x1, y2 - y1, exaScratch.op));
+    gp_declare_blt(flags);
     gp_pattern_fill(offset, x2 - x1, y2 - y1);
+
+    lx_hazard_record(flags, exaGetPixmapOffset(pxMap), pitch, bpp,
+                     x1, y1, x2 - x1, y2 - y1);
 }
 
 static Bool
@@ -362,9 +670,11 @@ lx_do_copy(PixmapPtr pxDst, int srcX, int srcY,
     int dstBpp = (pxDst->drawable.bitsPerPixel + 7) / 8;
     int dstPitch = exaGetPixmapPitch(pxDst);
     unsigned int srcOffset, dstOffset;
+    int hazard = lx_copy_flags(pxDst, srcX, srcY, dstX, dstY, w, h,
+                               exaScratch.op);
     int flags = 0;
 
-    gp_declare_blt(lx_copy_flags(srcX, srcY, dstX, dstY, w, h, exaScratch.op));
+    gp_declare_blt(hazard);
 
     srcOffset = exaScratch.srcOffset + (exaScratch.srcPitch * srcY) +
         (exaScratch.srcBpp) * srcX;
@@ -378,6 +688,9 @@ lx_do_copy(PixmapPtr pxDst, int srcX, int srcY,
         flags |= CIMGP_NEGYDIR;
 
     gp_screen_to_screen_blt(dstOffset, srcOffset, w, h, flags);
+
+    lx_hazard_record(hazard, exaGetPixmapOffset(pxDst), dstPitch, dstBpp,
+                     dstX, dstY, w, h);
 }
 
 /* Composite operations
@@ -504,6 +817,16 @@ lx_process_transform(PicturePtr pSrc)
     if (t->matrix[2][2] != F(1))
         return FALSE;
 
+    /* A scale without any rotation is resampled by the CPU, see
+     * lx_composite_scale() */
+
+    if (t->matrix[2][0] == 0 && t->matrix[2][1] == 0 && s0 == 0 && s1 == 0 &&
+        c0 > 0 && c1 > 0 && (c0 != F(1) || c1 != F(1))) {
+        exaScratch.scale = 1;
+        exaScratch.transform = pSrc->transform;
+        return TRUE;
+    }
+
     /* The rotate matrix looks like this:
      * [ cos X   -sin x 
      * sin X   cos X ]
@@ -539,45 +862,171 @@ lx_process_transform(PicturePtr pSrc)
 }
 
 static Bool
-lx_check_composite(int op, PicturePtr pSrc, PicturePtr pMsk, PicturePtr pDst)
+lx_fallback(int reason)
+{
+    lx_fallback_last = reason;
+    return FALSE;
+}
+
+/* A missing mask is counted with a format of 0 */
+
+static CARD32
+lx_fallback_format(PicturePtr pPict)
+{
+    return pPict ? pPict->format : 0;
+}
+
+static void
+lx_count_fallback(int reason, int op, PicturePtr pSrc, PicturePtr pMsk,
+                  PicturePtr pDst)
+{
+    CARD32 src = lx_fallback_format(pSrc);
+    CARD32 msk = lx_fallback_format(pMsk);
+    CARD32 dst = lx_fallback_format(pDst);
+    int i;
+
+    lx_fallbacks.fallbacks++;
+    lx_fallbacks.ops[(op >= 0 && op <= PictOpAdd) ? op : PictOpAdd + 1]++;
+
+    lx_fallbacks.reasons[reason]++;
+
+    for (i = 0; i < LX_FALLBACK_FORMATS; i++) {
+        if (lx_fallbacks.formats[i].count == 0) {
+            lx_fallbacks.formats[i].src = src;
+            lx_fallbacks.formats[i].msk = msk;
+            lx_fallbacks.formats[i].dst = dst;
+        }
+
+        if (lx_fallbacks.formats[i].src == src &&
+            lx_fallbacks.formats[i].msk == msk &&
+            lx_fallbacks.formats[i].dst == dst) {
+            lx_fallbacks.formats[i].count++;
+            return;
+        }
+    }
+
+    lx_fallbacks.otherFormats++;
+}
+
+/* Write the composite fallback counters to the log */
+
+void
+LXExaDumpFallbacks(ScrnInfoPtr pScrni)
+{
+    int i;
+
+    xf86DrvMsg(pScrni->scrnIndex, X_INFO,
+               "EXA: %lu of %lu composite operations fell back\n",
+               lx_fallbacks.fallbacks, lx_fallbacks.checks);
+
+    if (lx_fallbacks.fallbacks == 0)
+        return;
+
+    for (i = 0; i < LX_FALLBACK_REASONS; i++) {
+        if (lx_fallbacks.reasons[i] == 0)
+            continue;
+
+        xf86DrvMsg(pScrni->scrnIndex, X_INFO, "EXA: %8lu  %s\n",
+                   lx_fallbacks.reasons[i], lx_fallback_names[i]);
+    }
+
+    for (i = 0; i <= PictOpAdd + 1; i++) {
+        if (lx_fallbacks.ops[i] == 0)
+            continue;
+
+        if (i > PictOpAdd)
+            xf86DrvMsg(pScrni->scrnIndex, X_INFO,
+                       "EXA: %8lu  other operations\n", lx_fallbacks.ops[i]);
+        else
+            xf86DrvMsg(pScrni->scrnIndex, X_INFO,
+                       "EXA: %8lu  operation %d\n", lx_fallbacks.ops[i], i);
+    }
+
+    for (i = 0; i < LX_FALLBACK_FORMATS && lx_fallbacks.formats[i].count;
+         i++) {
+        xf86DrvMsg(pScrni->scrnIndex, X_INFO,
+                   "EXA: %8lu  src %08x mask %08x dst %08x\n",
+                   lx_fallbacks.formats[i].count,
+                   (unsigned int) lx_fallbacks.formats[i].src,
+                   (unsigned int) lx_fallbacks.formats[i].msk,
+                   (unsigned int) lx_fallbacks.formats[i].dst);
+    }
+
+    if (lx_fallbacks.otherFormats)
+        xf86DrvMsg(pScrni->scrnIndex, X_INFO,
+                   "EXA: %8lu  other formats\n", lx_fallbacks.otherFormats);
+}
+
+void
+LXExaResetFallbacks(void)
+{
+    memset(&lx_fallbacks, 0, sizeof(lx_fallbacks));
+}
+
+static Bool
+lx_can_composite(int op, PicturePtr pSrc, PicturePtr pMsk, PicturePtr pDst)
 {
     GeodeRec *pGeode = GEODEPTR_FROM_PICTURE(pDst);
     const struct exa_format_t *srcFmt, *dstFmt;
 
     if (op > PictOpAdd)
-        GEODE_FALLBACK(("Operation %d is not supported\n", op));
+        GEODE_FALLBACK(LX_FB_OP, ("Operation %d is not supported\n", op));
+
+    /* Solid and gradient sources without a mask skip the pixmap source
+     * checks below.  Solid ones are an alpha blended fill with the source
+     * color as a constant.  Horizontal and vertical linear gradients are
+     * drawn from a strip of their colors, and the other gradients are
+     * left to pixman. */
+
+    if (!pMsk && pSrc->pSourcePict &&
+        (pSrc->pSourcePict->type == SourcePictTypeSolidFill ||
+         pSrc->pSourcePict->type == SourcePictTypeLinear)) {
+        if (usesPasses(op))
+            GEODE_FALLBACK(LX_FB_SOURCE_PICT_PASSES, ("Solid and gradient source pictures are only supported with one pass operations\n"));
+
+        if (pSrc->pSourcePict->type == SourcePictTypeLinear) {
+            PictLinearGradient *g = &pSrc->pSourcePict->linear;
+
+            if (pSrc->transform)
+                GEODE_FALLBACK(LX_FB_GRADIENT_TRANSFORM, ("Gradient transforms are not supported\n"));
+
+            if (g->nstops < 1 ||
+                (g->p1.x == g->p2.x) == (g->p1.y == g->p2.y))
+                GEODE_FALLBACK(LX_FB_GRADIENT_DIRECTION, ("Only horizontal and vertical linear gradients are supported\n"));
+        }
+
+        if ((dstFmt = lx_get_format(pDst)) == NULL ||
+            pDst->format == PICT_a8)
+            GEODE_FALLBACK(LX_FB_DST_FORMAT, ("Unsupported destination format %x\n",
+                            pDst->format));
+
+        if (!dstFmt->alphabits && usesDstAlpha(op))
+            GEODE_FALLBACK(LX_FB_DST_ALPHA, ("Operation requires dst alpha, but alphabits is unset\n"));
+
+        return TRUE;
+    }
 
     /* XXX - don't know if we can do any hwaccel on solid fills or gradient types in generic cases */
     if (pMsk && pMsk->pSourcePict)
-        GEODE_FALLBACK(("%s are not supported as a mask\n",
+        GEODE_FALLBACK(LX_FB_MASK_PICT, ("%s are not supported as a mask\n",
                         pMsk->pSourcePict->type ==
                         SourcePictTypeSolidFill ? "Solid pictures" :
                         "Gradients"));
 
     if (pSrc->pSourcePict && pSrc->pSourcePict->type != SourcePictTypeSolidFill)
-        GEODE_FALLBACK(("Gradients are not supported as the source\n"));
+        GEODE_FALLBACK(LX_FB_GRADIENT_SRC, ("Gradients are not supported as the source\n"));
 
     if (pMsk && op == PictOpAdd)
-        GEODE_FALLBACK(("PictOpAdd with mask is not supported\n"));
-
-    /* FIXME: Meet this conditions from the debug for PictOpAdd.
-     * Any Other possibilities? Add a judge for the future supplement */
-    if (op == PictOpAdd && pSrc->format == PICT_a8r8g8b8 &&
-        pDst->format == PICT_a8)
-        return TRUE;
-
-    if (op == PictOpAdd && pSrc->format == PICT_x8r8g8b8 &&
-        pDst->format == PICT_a8)
-        return TRUE;
-
-    if (op == PictOpAdd && pSrc->format == PICT_r5g6b5 &&
-        pDst->format == PICT_a8)
-        return TRUE;
+        GEODE_FALLBACK(LX_FB_ADD_MASK, ("PictOpAdd with mask is not supported\n"));
 
     if (usesPasses(op)) {
-        /* FIXME: Slightly misleading fallback msg when !pMsk */
-        if (pGeode->exaBfrOffset == 0 || !pMsk)
-            GEODE_FALLBACK(("Multipass operation requires off-screen buffer\n"));
+        if (pGeode->exaBfrOffset == 0)
+            GEODE_FALLBACK(LX_FB_PASSES_BUFFER, ("Multipass operation requires off-screen buffer\n"));
+
+        /* Without a mask the destination is staged through the scratch
+         * buffer, which has to hold at least one line of it */
+        if (!pMsk && pDst->pDrawable->width * 4 > pGeode->exaBfrSz)
+            GEODE_FALLBACK(LX_FB_PASSES_WIDTH, ("Multipass destination is too wide for the off-screen buffer\n"));
     }
 
     /* Check that the filter matches what we support */
@@ -590,25 +1039,60 @@ lx_check_composite(int op, PicturePtr pSrc, PicturePtr pMsk, PicturePtr pDst)
         break;
 
     default:
-        GEODE_FALLBACK(("Bilinear or convolution filters are not supported\n"));
+        GEODE_FALLBACK(LX_FB_FILTER, ("Bilinear or convolution filters are not supported\n"));
     }
 
     if (pMsk && pMsk->transform)
-        GEODE_FALLBACK(("Mask transforms are not supported\n"));
+        GEODE_FALLBACK(LX_FB_MASK_TRANSFORM, ("Mask transforms are not supported\n"));
 
     /* Keep an eye out for source rotation transforms - those we can
      * do something about */
 
     exaScratch.rotate = RR_Rotate_0;
+    exaScratch.scale = 0;
     exaScratch.transform = NULL;
 
     if (pSrc->transform && !lx_process_transform(pSrc))
-        GEODE_FALLBACK(("Transform operation is non-trivial\n"));
+        GEODE_FALLBACK(LX_FB_TRANSFORM, ("Transform operation is non-trivial\n"));
+
+    if (exaScratch.scale) {
+        if (pMsk || usesPasses(op))
+            GEODE_FALLBACK(LX_FB_SCALE_OP, ("Scaling is only supported for one pass operations without a mask\n"));
+
+        /* Each of the scratch slots has to hold a line */
+        if (pGeode->exaBfrOffset == 0 ||
+            pDst->pDrawable->width * 4 * LX_SCRATCH_SLOTS > pGeode->exaBfrSz)
+            GEODE_FALLBACK(LX_FB_SCALE_BUFFER, ("Scaling requires off-screen buffer\n"));
+
+        exaScratch.bilinear = (pSrc->filter == PictFilterGood ||
+                               pSrc->filter == PictFilterBest);
+
+        if (exaScratch.bilinear && pSrc->pDrawable->bitsPerPixel != 32)
+            GEODE_FALLBACK(LX_FB_SCALE_BILINEAR, ("Bilinear scaling is only supported for 32bpp sources\n"));
+    }
 
-    /* XXX - I don't understand PICT_a8 enough - so I'm punting */
-    if ((op != PictOpAdd) && (pSrc->format == PICT_a8 ||
-                              pDst->format == PICT_a8))
-        GEODE_FALLBACK(("PICT_a8 as src or dst format is unsupported\n"));
+    if (usesPasses(op) && !pMsk && exaScratch.rotate != RR_Rotate_0)
+        GEODE_FALLBACK(LX_FB_PASSES_ROTATE, ("Multipass operations can not rotate the source\n"));
+
+    /* The GP can't blend into an alpha only destination other than
+     * adding bytes.  An a8 source is read as channel 3 alpha, which
+     * covers the operations that only need its alpha and black */
+
+    if (pDst->format == PICT_a8 &&
+        (op != PictOpAdd || pSrc->format != PICT_a8))
+        GEODE_FALLBACK(LX_FB_A8_DST, ("PICT_a8 as dst format is only supported with PictOpAdd from PICT_a8\n"));
+
+    if (pSrc->format == PICT_a8 && pDst->format != PICT_a8) {
+        if (pMsk)
+            GEODE_FALLBACK(LX_FB_A8_SRC_MASK, ("PICT_a8 as src format is unsupported with a mask\n"));
+
+        if (pDst->pDrawable->bitsPerPixel < 16)
+            GEODE_FALLBACK(LX_FB_A8_SRC_BPP, ("PICT_a8 as src format needs a 16 or 32bpp dst\n"));
+
+        if (op != PictOpOver && op != PictOpSrc && op != PictOpOutReverse &&
+            !(op == PictOpIn && PICT_FORMAT_A(pDst->format) == 0))
+            GEODE_FALLBACK(LX_FB_A8_SRC_OP, ("Operation %d is unsupported with a PICT_a8 src\n", op));
+    }
 
     if (pMsk && op != PictOpClear) {
         struct blend_ops_t *opPtr = &lx_alpha_ops[op * 2];
@@ -618,16 +1102,15 @@ lx_check_composite(int op, PicturePtr pSrc, PicturePtr pMsk, PicturePtr pDst)
         if (((direction == 0) &&
              (pSrc->pDrawable && pSrc->pDrawable->bitsPerPixel < 16)) ||
             ((direction == 1) && (pDst->pDrawable->bitsPerPixel < 16))) {
-            ErrorF("Mask blending unsupported with <16bpp\n");
-            return FALSE;
+            GEODE_FALLBACK(LX_FB_MASK_BPP, ("Mask blending unsupported with <16bpp\n"));
         }
         if (pMsk->format != PICT_a8 && pMsk->format != PICT_a4)
-            GEODE_FALLBACK(("Masks can be only done with a 8bpp or 4bpp depth\n"));
+            GEODE_FALLBACK(LX_FB_MASK_FORMAT, ("Masks can be only done with a 8bpp or 4bpp depth\n"));
 
         /* The pSrc should be 1x1 pixel if the pMsk is not zero */
         if (pSrc->pDrawable &&
             (pSrc->pDrawable->width != 1 || pSrc->pDrawable->height != 1))
-            GEODE_FALLBACK(("pSrc should be 1x1 pixel if pMsk is not zero\n"));
+            GEODE_FALLBACK(LX_FB_MASK_SRC_SIZE, ("pSrc should be 1x1 pixel if pMsk is not zero\n"));
         /* FIXME: In lx_prepare_composite, there are no variables to record the
          * one pixel source's width and height when the mask is not zero.
          * That will lead to bigger region to render instead of one pixel in lx
@@ -636,44 +1119,85 @@ lx_check_composite(int op, PicturePtr pSrc, PicturePtr pMsk, PicturePtr pDst)
         if (!pSrc->repeat &&
             !(pSrc->pSourcePict &&
               pSrc->pSourcePict->type == SourcePictTypeSolidFill)) {
-            GEODE_FALLBACK(("FIXME: unzero mask might lead to bigger rendering region than 1x1 pixels\n"));
+            GEODE_FALLBACK(LX_FB_MASK_SRC_REPEAT, ("FIXME: unzero mask might lead to bigger rendering region than 1x1 pixels\n"));
         }
     }
     else {
         if (pSrc->pSourcePict)
-            GEODE_FALLBACK(("Solid source pictures without a mask are not supported\n"));
+            GEODE_FALLBACK(LX_FB_GRADIENT_SRC, ("Gradients are not supported as the source\n"));
     }
 
     /* Get the formats for the source and destination */
 
     if ((srcFmt = lx_get_format(pSrc)) == NULL)
-        GEODE_FALLBACK(("Unsupported source format %x\n", pSrc->format));
+        GEODE_FALLBACK(LX_FB_SRC_FORMAT, ("Unsupported source format %x\n", pSrc->format));
 
     if ((dstFmt = lx_get_format(pDst)) == NULL)
-        GEODE_FALLBACK(("Unsupported destination format %x\n", pDst->format));
+        GEODE_FALLBACK(LX_FB_DST_FORMAT, ("Unsupported destination format %x\n", pDst->format));
 
     /* Make sure operations that need alpha bits have them */
     /* If a mask is enabled, the alpha will come from there */
 
     if (!pMsk && (!srcFmt->alphabits && usesSrcAlpha(op)))
-        GEODE_FALLBACK(("Operation requires src alpha, but alphabits is unset\n"));
+        GEODE_FALLBACK(LX_FB_SRC_ALPHA, ("Operation requires src alpha, but alphabits is unset\n"));
 
     if (!pMsk && (!dstFmt->alphabits && usesDstAlpha(op)))
-        GEODE_FALLBACK(("Operation requires dst alpha, but alphabits is unset\n"));
+        GEODE_FALLBACK(LX_FB_DST_ALPHA, ("Operation requires dst alpha, but alphabits is unset\n"));
 
     /* FIXME: See a way around this! */
     if (srcFmt->alphabits == 0 && dstFmt->alphabits != 0)
-        GEODE_FALLBACK(("src_alphabits=0, dst_alphabits!=0\n"));
-
-    /* If this is a rotate operation, then make sure the src and dst
-     * formats are the same */
-    if (exaScratch.rotate != RR_Rotate_0 && srcFmt != dstFmt) {
-        ErrorF("EXA: Unable to rotate and convert formats at the same time\n");
-        return FALSE;
+        GEODE_FALLBACK(LX_FB_ALPHABITS, ("src_alphabits=0, dst_alphabits!=0\n"));
+
+    /* If this is a rotate operation that converts formats, then the source
+     * is converted in the off-screen buffer, which has to hold at least
+     * one line of it */
+    if (exaScratch.rotate != RR_Rotate_0 && srcFmt != dstFmt &&
+        (pGeode->exaBfrOffset == 0 ||
+         pSrc->pDrawable->width * (dstFmt->bpp / 8) > pGeode->exaBfrSz)) {
+        GEODE_FALLBACK(LX_FB_ROTATE_CONVERT, ("Unable to rotate and convert formats at the same time\n"));
     }
     return TRUE;
 }
 
+static Bool
+lx_check_composite(int op, PicturePtr pSrc, PicturePtr pMsk, PicturePtr pDst)
+{
+    lx_fallbacks.checks++;
+
+    if (lx_can_composite(op, pSrc, pMsk, pDst))
+        return TRUE;
+
+    lx_count_fallback(lx_fallback_last, op, pSrc, pMsk, pDst);
+    return FALSE;
+}
+
+/* FNV-1a hash of everything that decides the colors of a gradient */
+
+static CARD32
+lx_gradient_hash(PictLinearGradient * g, int repeat)
+{
+    const unsigned char *p = (const unsigned char *) g->stops;
+    int i, size = g->nstops * sizeof(PictGradientStop);
+    CARD32 v[5];
+    CARD32 hash = 2166136261U;
+
+    for (i = 0; i < size; i++)
+        hash = (hash ^ p[i]) * 16777619U;
+
+    v[0] = g->p1.x;
+    v[1] = g->p1.y;
+    v[2] = g->p2.x;
+    v[3] = g->p2.y;
+    v[4] = repeat;
+
+    p = (const unsigned char *) v;
+
+    for (i = 0; i < (int) sizeof(v); i++)
+        hash = (hash ^ p[i]) * 16777619U;
+
+    return hash;
+}
+
 static Bool
 lx_prepare_composite(int op, PicturePtr pSrc, PicturePtr pMsk,
                      PicturePtr pDst, PixmapPtr pxSrc, PixmapPtr pxMsk,
@@ -694,6 +1218,7 @@ lx_prepare_composite(int op, PicturePtr pSrc, PicturePtr pMsk,
     exaScratch.op = op;
     exaScratch.repeat = pSrc->repeat;
     exaScratch.bufferOffset = pGeode->exaBfrOffset;
+    exaScratch.bufferSize = pGeode->exaBfrSz;
 
     if (pMsk && op != PictOpClear) {
         /* Get the source color */
@@ -732,10 +1257,59 @@ lx_prepare_composite(int op, PicturePtr pSrc, PicturePtr pMsk,
 
         /* Flag to indicate if this a 8BPP or a 4BPP mask */
         exaScratch.fourBpp = (pxMsk->drawable.bitsPerPixel == 4) ? 1 : 0;
+
+        /* An opaque source color over the destination through the mask
+         * is a single blend with the mask as the alpha, which is what
+         * anti-aliased text mostly is */
+
+        exaScratch.solidMask = 0;
+        exaScratch.runStarted = 0;
+
+        if (op == PictOpOver && (exaScratch.srcColor >> 24) == 0xFF &&
+            (pSrc->pSourcePict || pSrc->format == PICT_a8r8g8b8 ||
+             srcFmt->alphabits == 0) && pxDst->drawable.bitsPerPixel >= 16) {
+            CARD16 red, green, blue, alpha;
+            CARD32 color = exaScratch.srcColor;
+
+            _GetRGBAFromPixel(color, &red, &green, &blue, &alpha,
+                              PICT_a8r8g8b8);
+            _GetPixelFromRGBA(&color, red, green, blue, alpha, pDst->format);
+
+            exaScratch.solidMask = 1;
+            exaScratch.srcColor = color;
+        }
+    }
+    else if (pSrc->pSourcePict &&
+             pSrc->pSourcePict->type == SourcePictTypeLinear) {
+        PictLinearGradient *g = &pSrc->pSourcePict->linear;
+
+        exaScratch.type = COMP_TYPE_GRADIENT;
+        exaScratch.gradient = g;
+        exaScratch.gradientRepeat = pSrc->repeat ? pSrc->repeatType :
+            RepeatNone;
+        exaScratch.gradientVertical = (g->p1.x == g->p2.x);
+        exaScratch.gradientHash = lx_gradient_hash(g,
+                                                   exaScratch.gradientRepeat);
+    }
+    else if (pSrc->pSourcePict) {
+        CARD16 red, green, blue, alpha;
+        CARD32 color = pSrc->pSourcePict->solidFill.color;
+
+        /* Convert the source color to the destination format, and keep
+         * its alpha to use as a constant alpha value */
+
+        _GetRGBAFromPixel(color, &red, &green, &blue, &alpha, PICT_a8r8g8b8);
+        _GetPixelFromRGBA(&color, red, green, blue, alpha, pDst->format);
+
+        exaScratch.type = COMP_TYPE_SOLID;
+        exaScratch.srcColor = color;
+        exaScratch.srcAlpha = alpha >> 8;
     }
     else {
         if (usesPasses(op))
             exaScratch.type = COMP_TYPE_TWOPASS;
+        else if (exaScratch.scale)
+            exaScratch.type = COMP_TYPE_SCALE;
         else if (exaScratch.rotate != RR_Rotate_0)
             exaScratch.type = COMP_TYPE_ROTATE;
         else
@@ -879,26 +1453,84 @@ lx_composite_onepass_add_a8(PixmapPtr pxDst, unsigned long dstOffset,
     }
 }
 
+/* A PICT_a8 source pixel is (0, 0, 0, a), so the operations we allow
+ * with it come down to scaling the destination by the source alpha,
+ * blending in black, or both.  The GP does that with the source pixmap
+ * read as 8BPP channel 3 alpha and a solid opaque black source color */
+
 static void
-lx_composite_onepass(PixmapPtr pxDst, unsigned long dstOffset,
-                     unsigned long srcOffset, int width, int height)
+lx_composite_a8_source(int op, unsigned long dstOffset,
+                       unsigned long dstPitch, unsigned long srcOffset,
+                       unsigned long srcPitch, int width, int height,
+                       int flags)
 {
-    struct blend_ops_t *opPtr;
+    unsigned long black;
+    int operation;
+
+    switch (op) {
+    case PictOpOver:
+        operation = CIMGP_ALPHA_A_PLUS_BETA_B;
+        break;
+    case PictOpOutReverse:
+        operation = CIMGP_BETA_TIMES_B;
+        break;
+    default:                   /* PictOpSrc, PictOpIn without dst alpha */
+        operation = CIMGP_ALPHA_TIMES_A;
+        break;
+    }
+
+    switch (exaScratch.dstFormat->exa) {
+    case PICT_a8r8g8b8:
+        black = 0xFF000000;
+        break;
+    case PICT_a4r4g4b4:
+        black = 0xF000;
+        break;
+    case PICT_a1r5g5b5:
+        black = 0x8000;
+        break;
+    default:
+        black = 0;
+        break;
+    }
+
+    gp_declare_blt(flags);
+    gp_set_bpp(lx_get_bpp_from_format(exaScratch.dstFormat->fmt));
+    gp_set_strides(dstPitch, srcPitch);
+    gp_set_solid_source(black);
+    gp_blend_mask_blt(dstOffset, 0, width, height, srcOffset, srcPitch,
+                      operation, 0);
+}
+
+/* Blend one pass of an operation, using its one pass entry.  Both
+ * surfaces are in screen memory, and the source is converted to the
+ * destination format on the way */
+
+static void
+lx_composite_pass(int op, unsigned long dstOffset, unsigned long dstPitch,
+                  unsigned long srcOffset, unsigned long srcPitch,
+                  struct exa_format_t *srcFmt, int width, int height,
+                  int flags)
+{
+    struct blend_ops_t *opPtr = &lx_alpha_ops[op * 2];
     int apply, type;
 
-    opPtr = &lx_alpha_ops[exaScratch.op * 2];
+    if (srcFmt->exa == PICT_a8) {
+        lx_composite_a8_source(op, dstOffset, dstPitch, srcOffset, srcPitch,
+                               width, height, flags);
+        return;
+    }
 
-    apply = (exaScratch.dstFormat->alphabits != 0 &&
-             exaScratch.srcFormat->alphabits != 0) ?
+    apply = (exaScratch.dstFormat->alphabits != 0 && srcFmt->alphabits != 0) ?
         CIMGP_APPLY_BLEND_TO_ALL : CIMGP_APPLY_BLEND_TO_RGB;
 
-    gp_declare_blt(0);
+    gp_declare_blt(flags);
     gp_set_bpp(lx_get_bpp_from_format(exaScratch.dstFormat->fmt));
-    gp_set_strides(exaGetPixmapPitch(pxDst), exaScratch.srcPitch);
+    gp_set_strides(dstPitch, srcPitch);
 
-    lx_set_source_format(exaScratch.srcFormat->fmt, exaScratch.dstFormat->fmt);
+    lx_set_source_format(srcFmt->fmt, exaScratch.dstFormat->fmt);
 
-    type = get_op_type(exaScratch.srcFormat, exaScratch.dstFormat, opPtr->type);
+    type = get_op_type(srcFmt, exaScratch.dstFormat, opPtr->type);
 
     gp_set_alpha_operation(opPtr->operation, type, opPtr->channel, apply, 0);
 
@@ -906,30 +1538,54 @@ lx_composite_onepass(PixmapPtr pxDst, unsigned long dstOffset,
 }
 
 static void
-lx_composite_all_black(unsigned long srcOffset, int width, int height)
+lx_composite_onepass(PixmapPtr pxDst, unsigned long dstOffset,
+                     unsigned long srcOffset, int width, int height)
+{
+    lx_composite_pass(exaScratch.op, dstOffset, exaGetPixmapPitch(pxDst),
+                      srcOffset, exaScratch.srcPitch, exaScratch.srcFormat,
+                      width, height, 0);
+}
+
+/* A solid source is fed to the GP as the constant source color of a fill.
+ * Where the operation needs the source alpha, it is supplied as a constant
+ * alpha instead, which also works when the destination has no alpha */
+
+static void
+lx_composite_solid(PixmapPtr pxDst, unsigned long dstOffset, int width,
+                   int height)
 {
     struct blend_ops_t *opPtr;
     int apply, type;
+    unsigned char alpha = 0;
+
+    opPtr = &lx_alpha_ops[exaScratch.op * 2];
+    type = opPtr->type;
+
+    if ((type == CIMGP_CHANNEL_A_ALPHA &&
+         opPtr->channel == CIMGP_CHANNEL_A_SOURCE) ||
+        (type == CIMGP_CHANNEL_B_ALPHA &&
+         opPtr->channel == CIMGP_CHANNEL_A_DEST)) {
+        type = CIMGP_CONSTANT_ALPHA;
+        alpha = exaScratch.srcAlpha;
+    }
 
-    opPtr = &lx_alpha_ops[0];
-    apply = (exaScratch.srcFormat->alphabits != 0) ?
+    apply = (exaScratch.dstFormat->alphabits != 0) ?
         CIMGP_APPLY_BLEND_TO_ALL : CIMGP_APPLY_BLEND_TO_RGB;
-    gp_declare_blt(0);
-    gp_set_bpp(lx_get_bpp_from_format(exaScratch.srcFormat->fmt));
-    gp_set_strides(exaScratch.srcPitch, exaScratch.srcPitch);
-    lx_set_source_format(exaScratch.srcFormat->fmt, exaScratch.srcFormat->fmt);
-    type = get_op_type(exaScratch.srcFormat, exaScratch.srcFormat, opPtr->type);
-    gp_set_alpha_operation(opPtr->operation, type, opPtr->channel, apply, 0);
-    gp_screen_to_screen_convert(srcOffset, srcOffset, width, height, 0);
 
+    gp_declare_blt(0);
+    gp_set_bpp(lx_get_bpp_from_format(exaScratch.dstFormat->fmt));
+    gp_set_strides(exaGetPixmapPitch(pxDst), 0);
+    gp_set_alpha_operation(opPtr->operation, type, opPtr->channel, apply,
+                           alpha);
+    gp_set_solid_pattern(0);
+    gp_set_solid_source(exaScratch.srcColor);
+    gp_pattern_fill(dstOffset, width, height);
 }
 
 static void
 lx_composite_onepass_special(PixmapPtr pxDst, int width, int height, int opX,
                              int opY, int srcX, int srcY)
 {
-    struct blend_ops_t *opPtr;
-    int apply, type;
     int opWidth, opHeight;
     int optempX, optempY;
     unsigned int dstOffset, srcOffset = 0;
@@ -956,20 +1612,7 @@ lx_composite_onepass_special(PixmapPtr pxDst, int width, int height, int opX,
     while (1) {
         gp_wait_until_idle();
         dstOffset = GetPixmapOffset(pxDst, optempX, optempY);
-        opPtr = &lx_alpha_ops[exaScratch.op * 2];
-        apply = (exaScratch.dstFormat->alphabits != 0 &&
-                 exaScratch.srcFormat->alphabits != 0) ?
-            CIMGP_APPLY_BLEND_TO_ALL : CIMGP_APPLY_BLEND_TO_RGB;
-        gp_declare_blt(0);
-        gp_set_bpp(lx_get_bpp_from_format(exaScratch.dstFormat->fmt));
-        gp_set_strides(exaGetPixmapPitch(pxDst), exaScratch.srcPitch);
-        lx_set_source_format(exaScratch.srcFormat->fmt,
-                             exaScratch.dstFormat->fmt);
-        type = get_op_type(exaScratch.srcFormat, exaScratch.dstFormat,
-                           opPtr->type);
-        gp_set_alpha_operation(opPtr->operation, type, opPtr->channel,
-                               apply, 0);
-        gp_screen_to_screen_convert(dstOffset, srcOffset, opWidth, opHeight, 0);
+        lx_composite_onepass(pxDst, dstOffset, srcOffset, opWidth, opHeight);
 
         optempX += opWidth;
         if (optempX >= opX + width) {
@@ -1004,102 +1647,377 @@ lx_composite_onepass_special(PixmapPtr pxDst, int width, int height, int opX,
     }
 }
 
-/* This function handles the multipass blend functions */
+/* This function handles the multipass blend functions.  Each of them is
+ * the sum of a source term and a destination term:
+ *
+ *   Atop        = S * da       + D * (1 - sa)
+ *   AtopReverse = S * (1 - da) + D * sa
+ *   Xor         = S * (1 - da) + D * (1 - sa)
+ *
+ * The destination is copied to the scratch buffer where the destination
+ * term is blended in, the source term is blended into the destination
+ * in place, and then the scratch buffer is added back.  The scratch
+ * buffer is in the destination format, and the area is worked through
+ * in bands of as many lines as fit in it. */
 
 static void
 lx_composite_multipass(PixmapPtr pxDst, unsigned long dstOffset,
                        unsigned long srcOffset, int width, int height)
 {
-    struct blend_ops_t *opPtr;
-    int sbpp = lx_get_bpp_from_format(exaScratch.srcFormat->fmt);
-    int apply, type;
+    unsigned long dstPitch = exaGetPixmapPitch(pxDst);
+    int dbpp = lx_get_bpp_from_format(exaScratch.dstFormat->fmt);
+    unsigned long tmpPitch = width * ((dbpp + 7) / 8);
+    int dstOp, srcOp;
+    int lines;
+
+    switch (exaScratch.op) {
+    case PictOpAtop:
+        dstOp = PictOpOutReverse;
+        srcOp = PictOpIn;
+        break;
+    case PictOpAtopReverse:
+        dstOp = PictOpInReverse;
+        srcOp = PictOpOut;
+        break;
+    default:                   /* PictOpXor */
+        dstOp = PictOpOutReverse;
+        srcOp = PictOpOut;
+        break;
+    }
 
-    /* Wait until the GP is idle - this will ensure that the scratch buffer
-     * isn't occupied */
+    lines = exaScratch.bufferSize / tmpPitch;
 
-    gp_wait_until_idle();
+    while (height > 0) {
+        if (lines > height)
+            lines = height;
 
-    /* Copy the destination to the scratch buffer, and convert it to the
-     * source format */
+        /* Copy the destination to the scratch buffer.  The hazard flag
+         * keeps us from overwriting it while the previous band is still
+         * being read back */
 
-    gp_declare_blt(0);
+        gp_declare_blt(CIMGP_BLTFLAGS_HAZARD);
+        gp_set_bpp(dbpp);
+        gp_set_raster_operation(0xCC);
+        gp_set_strides(tmpPitch, dstPitch);
+        gp_screen_to_screen_blt(exaScratch.bufferOffset, dstOffset,
+                                width, lines, 0);
 
-    gp_set_bpp(sbpp);
-    gp_set_source_format(exaScratch.dstFormat->fmt);
-    gp_set_raster_operation(0xCC);
-    gp_set_strides(exaScratch.srcPitch, exaGetPixmapPitch(pxDst));
-    gp_screen_to_screen_convert(exaScratch.bufferOffset, dstOffset,
-                                width, height, 0);
+        /* Blend the destination term in the scratch buffer */
+
+        lx_composite_pass(dstOp, exaScratch.bufferOffset, tmpPitch,
+                          srcOffset, exaScratch.srcPitch,
+                          exaScratch.srcFormat, width, lines,
+                          CIMGP_BLTFLAGS_HAZARD);
+
+        /* Blend the source term in the destination */
+
+        lx_composite_pass(srcOp, dstOffset, dstPitch, srcOffset,
+                          exaScratch.srcPitch, exaScratch.srcFormat,
+                          width, lines, 0);
+
+        /* And add the two together */
+
+        lx_composite_pass(PictOpAdd, dstOffset, dstPitch,
+                          exaScratch.bufferOffset, tmpPitch,
+                          exaScratch.dstFormat, width, lines,
+                          CIMGP_BLTFLAGS_HAZARD);
+
+        dstOffset += lines * dstPitch;
+        srcOffset += lines * exaScratch.srcPitch;
+        height -= lines;
+    }
+}
+
+/* A repeating source that is smaller than the destination is first
+ * expanded in the scratch buffer.  The source tile is copied in once and
+ * then doubled horizontally and vertically, so it takes a logarithmic
+ * number of blts to get an image that covers the whole destination, or
+ * as much of it as the scratch buffer holds.  The destination is then
+ * blended from it in a few large blts instead of one per source tile.
+ * Returns FALSE if the source doesn't fit in the scratch buffer. */
+
+static Bool
+lx_composite_repeat(PixmapPtr pxDst, int dstX, int dstY, int srcX, int srcY,
+                    int width, int height)
+{
+    int sw = exaScratch.srcWidth, sh = exaScratch.srcHeight;
+    int bpp = exaScratch.srcBpp;
+    int sbpp = lx_get_bpp_from_format(exaScratch.srcFormat->fmt);
+    unsigned long offset = exaScratch.bufferOffset;
+    unsigned long pitch;
+    int ew, eh, cw, ch, x, y, px, py, w, h;
+    int flags = CIMGP_BLTFLAGS_HAZARD;
+
+    if (sw >= width && sh >= height)
+        return FALSE;
+
+    if (offset == 0 || sw * sh * bpp > exaScratch.bufferSize)
+        return FALSE;
+
+    srcX = ((srcX % sw) + sw) % sw;
+    srcY = ((srcY % sh) + sh) % sh;
+
+    /* Size the expanded image to cover the destination from the starting
+     * point in the source, within the limits of the scratch buffer */
+
+    ew = srcX + width;
+    if (ew * bpp * sh > exaScratch.bufferSize)
+        ew = exaScratch.bufferSize / (bpp * sh);
+
+    pitch = ew * bpp;
 
-    /* Do the first blend from the source to the scratch buffer */
+    eh = srcY + height;
+    if (eh * pitch > exaScratch.bufferSize)
+        eh = exaScratch.bufferSize / pitch;
 
     gp_declare_blt(CIMGP_BLTFLAGS_HAZARD);
     gp_set_bpp(sbpp);
-    gp_set_source_format(exaScratch.srcFormat->fmt);
-    gp_set_strides(exaScratch.srcPitch, exaScratch.srcPitch);
+    gp_set_raster_operation(0xCC);
+    gp_set_strides(pitch, exaScratch.srcPitch);
+    gp_screen_to_screen_blt(offset, exaScratch.srcOffset, sw, sh, 0);
 
-    opPtr = &lx_alpha_ops[exaScratch.op * 2];
+    for (cw = sw; cw < ew; cw += w) {
+        w = (ew - cw) < cw ? (ew - cw) : cw;
 
-    apply = (exaScratch.srcFormat->alphabits == 0) ?
-        CIMGP_APPLY_BLEND_TO_RGB : CIMGP_APPLY_BLEND_TO_ALL;
+        gp_declare_blt(CIMGP_BLTFLAGS_HAZARD);
+        gp_set_bpp(sbpp);
+        gp_set_raster_operation(0xCC);
+        gp_set_strides(pitch, pitch);
+        gp_screen_to_screen_blt(offset + (cw * bpp), offset, w, sh, 0);
+    }
 
-    /* If we're destroying the source alpha bits, then make sure we
-     * use the alpha before the color conversion
-     */
+    for (ch = sh; ch < eh; ch += h) {
+        h = (eh - ch) < ch ? (eh - ch) : ch;
 
-    gp_screen_to_screen_blt(exaScratch.bufferOffset, srcOffset, width, height,
-                            0);
+        gp_declare_blt(CIMGP_BLTFLAGS_HAZARD);
+        gp_set_bpp(sbpp);
+        gp_set_raster_operation(0xCC);
+        gp_set_strides(pitch, pitch);
+        gp_screen_to_screen_blt(offset + (ch * pitch), offset, ew, h, 0);
+    }
 
-    /* Finally, do the second blend back to the destination */
+    /* The expanded image repeats with the period of the source, so any
+     * point in it with the right phase can start the next blt */
 
-    opPtr = &lx_alpha_ops[(exaScratch.op * 2) + 1];
+    for (y = 0, py = srcY; y < height; y += h) {
+        h = (height - y) < (eh - py) ? (height - y) : (eh - py);
 
-    apply = (exaScratch.dstFormat->alphabits == 0) ?
-        CIMGP_APPLY_BLEND_TO_RGB : CIMGP_APPLY_BLEND_TO_ALL;
+        for (x = 0, px = srcX; x < width; x += w) {
+            w = (width - x) < (ew - px) ? (width - x) : (ew - px);
 
-    gp_declare_blt(CIMGP_BLTFLAGS_HAZARD);
-    gp_set_bpp(lx_get_bpp_from_format(exaScratch.dstFormat->fmt));
+            lx_composite_pass(exaScratch.op,
+                              GetPixmapOffset(pxDst, dstX + x, dstY + y),
+                              exaGetPixmapPitch(pxDst),
+                              offset + (py * pitch) + (px * bpp), pitch,
+                              exaScratch.srcFormat, w, h, flags);
 
-    lx_set_source_format(exaScratch.srcFormat->fmt, exaScratch.dstFormat->fmt);
+            flags = 0;
+            px = (px + w) % sw;
+        }
 
-    type = get_op_type(exaScratch.srcFormat, exaScratch.dstFormat, opPtr->type);
+        py = (py + h) % sh;
+    }
 
-    gp_set_alpha_operation(opPtr->operation, type, opPtr->channel, apply, 0);
+    return TRUE;
+}
+
+/* Operations that leave the destination cleared where the source is
+ * transparent, as it is outside of a non repeating source */
+
+static Bool
+lx_op_clears_outside(int op)
+{
+    switch (op) {
+    case PictOpClear:
+    case PictOpSrc:
+    case PictOpIn:
+    case PictOpInReverse:
+    case PictOpOut:
+    case PictOpAtopReverse:
+        return TRUE;
+    }
 
-    gp_screen_to_screen_convert(dstOffset, exaScratch.bufferOffset,
-                                width, height, 0);
+    return FALSE;
 }
 
 static void
-lx_composite_rotate(PixmapPtr pxDst, unsigned long dstOffset,
-                    unsigned int srcOffset, int width, int height)
+lx_composite_clear(PixmapPtr pxDst, int x, int y, int width, int height)
 {
-    int degrees = 0;
+    int pitch = exaGetPixmapPitch(pxDst);
+
+    if (width <= 0 || height <= 0)
+        return;
 
     gp_declare_blt(0);
-    gp_set_bpp(lx_get_bpp_from_format(exaScratch.dstFormat->fmt));
-    gp_set_strides(exaGetPixmapPitch(pxDst), exaScratch.srcPitch);
+    gp_set_bpp(pxDst->drawable.bitsPerPixel);
+    gp_set_raster_operation(0xCC);
+    gp_set_solid_source(0);
+    gp_set_strides(pitch, pitch);
+    gp_pattern_fill(GetPixmapOffset(pxDst, x, y), width, height);
+}
 
-    lx_set_source_format(exaScratch.srcFormat->fmt, exaScratch.dstFormat->fmt);
+/* Clear the part of the operation outside of the rectangle that the
+ * source covers, given relative to the origin of the operation, if the
+ * operation clears where the source is transparent */
 
-    gp_set_raster_operation(0xCC);
+static void
+lx_composite_clear_outside(PixmapPtr pxDst, int dstX, int dstY, int width,
+                           int height, int x0, int y0, int x1, int y1)
+{
+    if (!lx_op_clears_outside(exaScratch.op))
+        return;
+
+    if (x0 >= x1 || y0 >= y1) {
+        /* Nothing is inside, so it all goes in the top band */
+        x0 = x1 = 0;
+        y0 = y1 = height;
+    }
+
+    lx_composite_clear(pxDst, dstX, dstY, width, y0);
+    lx_composite_clear(pxDst, dstX, dstY + y1, width, height - y1);
+    lx_composite_clear(pxDst, dstX, dstY + y0, x0, y1 - y0);
+    lx_composite_clear(pxDst, dstX + x1, dstY + y0, width - x1, y1 - y0);
+}
+
+/* Composite from a non repeating source.  The part of the destination
+ * that the source covers is blended in one go.  Outside of it the source
+ * is transparent, so the rest is either left alone or cleared in at most
+ * four rectangles, depending on the operation.  srcX and srcY may be
+ * negative or beyond the source. */
+
+static void
+lx_composite_bounded(PixmapPtr pxDst, int dstX, int dstY, int srcX, int srcY,
+                     int width, int height)
+{
+    int x0, y0, x1, y1;
+
+    /* The part of the operation inside the source, relative to the origin
+     * of the operation */
+
+    x0 = (srcX < 0) ? -srcX : 0;
+    y0 = (srcY < 0) ? -srcY : 0;
+    x1 = ((int) exaScratch.srcWidth - srcX < width) ?
+        (int) exaScratch.srcWidth - srcX : width;
+    y1 = ((int) exaScratch.srcHeight - srcY < height) ?
+        (int) exaScratch.srcHeight - srcY : height;
+
+    if (x0 < x1 && y0 < y1) {
+        unsigned long dstOffset = GetPixmapOffset(pxDst, dstX + x0, dstY + y0);
+        unsigned long srcOffset = GetSrcOffset(srcX + x0, srcY + y0);
+
+        if (exaScratch.type == COMP_TYPE_TWOPASS)
+            lx_composite_multipass(pxDst, dstOffset, srcOffset, x1 - x0,
+                                   y1 - y0);
+        else if (exaScratch.op == PictOpAdd &&
+                 exaScratch.srcFormat->exa == PICT_a8 &&
+                 exaScratch.dstFormat->exa == PICT_a8)
+            lx_composite_onepass_add_a8(pxDst, dstOffset, srcOffset, x1 - x0,
+                                        y1 - y0, dstX + x0, dstY + y0,
+                                        srcX + x0, srcY + y0);
+        else
+            lx_composite_onepass(pxDst, dstOffset, srcOffset, x1 - x0,
+                                 y1 - y0);
+    }
+
+    lx_composite_clear_outside(pxDst, dstX, dstY, width, height,
+                               x0, y0, x1, y1);
+}
 
+static int
+lx_rotate_degrees(void)
+{
     /* RandR rotation is counter-clockwise, our rotation
      * is clockwise, so adjust the numbers accordingly */
 
     switch (exaScratch.rotate) {
     case RR_Rotate_90:
-        degrees = 270;
-        break;
+        return 270;
     case RR_Rotate_180:
-        degrees = 180;
-        break;
+        return 180;
     case RR_Rotate_270:
-        degrees = 90;
-        break;
+        return 90;
+    }
+
+    return 0;
+}
+
+/* The GP can't convert formats while it rotates, so a source in another
+ * format is converted into the scratch buffer first, and rotated from
+ * there.  The source is worked through in bands of as many lines as fit
+ * in the scratch buffer, and each band lands in its own strip of the
+ * destination. */
+
+static void
+lx_composite_rotate_convert(PixmapPtr pxDst, unsigned long dstOffset,
+                            unsigned int srcOffset, int width, int height)
+{
+    int dbpp = lx_get_bpp_from_format(exaScratch.dstFormat->fmt);
+    int dBytes = (dbpp + 7) / 8;
+    unsigned long dstPitch = exaGetPixmapPitch(pxDst);
+    unsigned long tmpPitch = width * dBytes;
+    int degrees = lx_rotate_degrees();
+    int lines = exaScratch.bufferSize / tmpPitch;
+    unsigned long offset;
+    int y;
+
+    for (y = 0; y < height; y += lines) {
+        if (lines > height - y)
+            lines = height - y;
+
+        gp_declare_blt(CIMGP_BLTFLAGS_HAZARD);
+        gp_set_bpp(dbpp);
+        gp_set_strides(tmpPitch, exaScratch.srcPitch);
+        lx_set_source_format(exaScratch.srcFormat->fmt,
+                             exaScratch.dstFormat->fmt);
+        gp_set_raster_operation(0xCC);
+        gp_screen_to_screen_convert(exaScratch.bufferOffset,
+                                    srcOffset + (y * exaScratch.srcPitch),
+                                    width, lines, 0);
+
+        switch (degrees) {
+        case 90:
+            offset = dstOffset + ((height - y - lines) * dBytes);
+            break;
+        case 180:
+            offset = dstOffset + ((height - y - lines) * dstPitch);
+            break;
+        case 270:
+            offset = dstOffset + (y * dBytes);
+            break;
+        default:
+            offset = dstOffset + (y * dstPitch);
+            break;
+        }
+
+        gp_declare_blt(CIMGP_BLTFLAGS_HAZARD);
+        gp_set_bpp(dbpp);
+        gp_set_strides(dstPitch, tmpPitch);
+        lx_set_source_format(exaScratch.dstFormat->fmt,
+                             exaScratch.dstFormat->fmt);
+        gp_set_raster_operation(0xCC);
+        gp_rotate_blt(offset, exaScratch.bufferOffset, width, lines, degrees);
+    }
+}
+
+static void
+lx_composite_rotate(PixmapPtr pxDst, unsigned long dstOffset,
+                    unsigned int srcOffset, int width, int height)
+{
+    if (exaScratch.srcFormat != exaScratch.dstFormat) {
+        lx_composite_rotate_convert(pxDst, dstOffset, srcOffset, width,
+                                    height);
+        return;
     }
 
-    gp_rotate_blt(dstOffset, srcOffset, width, height, degrees);
+    gp_declare_blt(0);
+    gp_set_bpp(lx_get_bpp_from_format(exaScratch.dstFormat->fmt));
+    gp_set_strides(exaGetPixmapPitch(pxDst), exaScratch.srcPitch);
+
+    lx_set_source_format(exaScratch.srcFormat->fmt, exaScratch.dstFormat->fmt);
+
+    gp_set_raster_operation(0xCC);
+
+    gp_rotate_blt(dstOffset, srcOffset, width, height, lx_rotate_degrees());
 }
 
 static void
@@ -1120,6 +2038,35 @@ lx_do_composite_mask(PixmapPtr pxDst, unsigned long dstOffset,
                       exaScratch.fourBpp);
 }
 
+/* Blend an opaque source color through the mask.  The composites that
+ * follow one prepare, such as the glyphs of a run from the glyph cache,
+ * all use the same destination, mask pixmap and color, and the GP keeps
+ * its registers between blts.  So while nothing else has been queued
+ * since the previous glyph, which the command marker shows, the stride
+ * and color are left as they are and the glyph only carries its offsets
+ * and size. */
+
+static void
+lx_do_composite_mask_solid(PixmapPtr pxDst, unsigned long dstOffset,
+                           unsigned int maskOffset, int width, int height)
+{
+    gp_declare_blt(0);
+    gp_set_bpp(lx_get_bpp_from_format(exaScratch.dstFormat->fmt));
+
+    if (!exaScratch.runStarted ||
+        exaScratch.runMarker != gp_get_command_marker()) {
+        gp_set_strides(exaGetPixmapPitch(pxDst), exaScratch.srcPitch);
+        gp_set_solid_source(exaScratch.srcColor);
+        exaScratch.runStarted = 1;
+    }
+
+    gp_blend_mask_blt(dstOffset, 0, width, height, maskOffset,
+                      exaScratch.srcPitch, CIMGP_ALPHA_A_PLUS_BETA_B,
+                      exaScratch.fourBpp);
+
+    exaScratch.runMarker = gp_get_command_marker();
+}
+
 static void
 lx_do_composite_mask_two_pass(PixmapPtr pxDst, unsigned long dstOffset,
                               unsigned int maskOffset, int width, int height,
@@ -1129,30 +2076,45 @@ lx_do_composite_mask_two_pass(PixmapPtr pxDst, unsigned long dstOffset,
     struct blend_ops_t *opPtr;
     int opWidth, opHeight;
     int opoverX, opoverY;
+    unsigned long slotSize, slotOffset;
+    int slots = LX_SCRATCH_SLOTS;
 
     opoverX = opX;
     opoverY = opY;
 
-    /* The rendering region should not be bigger than off-screen memory size
-     * which equals to DEFAULT_EXA_SCRATCH_BFRSZ. If that happens, we split
-     * the PictOpOver rendering region into several 256KB chunks. And because
-     * of the Pitch(stride) parameter, so we use maximun width of mask picture.
-     * that is to say it is a scanline rendering process */
-    if (width * height * 4 > DEFAULT_EXA_SCRATCH_BFRSZ) {
-        opWidth = width;
-        opHeight = DEFAULT_EXA_SCRATCH_BFRSZ / (width * 4);
-    }
-    else {
-        opWidth = width;
-        opHeight = height;
+    /* The rendering region has to fit in a scratch slot.  If it doesn't,
+     * we split the rendering region into bands of full mask width lines,
+     * that is to say it is a scanline rendering process.  Very wide
+     * operations use the whole buffer as a single slot */
+
+    slotSize = exaScratch.bufferSize / LX_SCRATCH_SLOTS;
+
+    if (width * 4 > slotSize) {
+        slotSize = exaScratch.bufferSize;
+        slots = 1;
     }
 
+    opWidth = width;
+    opHeight = height;
+
+    if (width * height * 4 > slotSize)
+        opHeight = slotSize / (width * 4);
+
     while (1) {
+        int slot = lx_scratch_next % slots;
 
-        /* Wait until the GP is idle - this will ensure that the scratch buffer
-         * isn't occupied */
+        lx_scratch_next = (slot + 1) % slots;
+        slotOffset = exaScratch.bufferOffset + (slot * slotSize);
 
-        gp_wait_until_idle();
+        /* Wait until the slot isn't read anymore by an earlier band.  The
+         * GP can carry on with the bands in the other slots meanwhile.
+         * With a single slot there is nothing to overlap, so the whole
+         * buffer is waited for */
+
+        if (slots == 1)
+            gp_wait_until_idle();
+        else if (lx_scratch_slots[slot].used)
+            gp_wait_command_marker(lx_scratch_slots[slot].marker);
 
         /* Copy the source to the scratch buffer, and do a src * mask raster
          * operation */
@@ -1163,7 +2125,7 @@ lx_do_composite_mask_two_pass(PixmapPtr pxDst, unsigned long dstOffset,
         gp_set_strides(opWidth * 4, exaScratch.srcPitch);
         gp_set_bpp(lx_get_bpp_from_format(CIMGP_SOURCE_FMT_8_8_8_8));
         gp_set_solid_source(exaScratch.srcColor);
-        gp_blend_mask_blt(exaScratch.bufferOffset, 0, opWidth, opHeight,
+        gp_blend_mask_blt(slotOffset, 0, opWidth, opHeight,
                           maskOffset, exaScratch.srcPitch, opPtr->operation,
                           exaScratch.fourBpp);
 
@@ -1180,23 +2142,652 @@ lx_do_composite_mask_two_pass(PixmapPtr pxDst, unsigned long dstOffset,
         type = CIMGP_CONVERTED_ALPHA;
         gp_set_alpha_operation(opPtr->operation, type, opPtr->channel,
                                apply, 0);
-        gp_screen_to_screen_convert(dstOffset, exaScratch.bufferOffset,
+        gp_screen_to_screen_convert(dstOffset, slotOffset,
                                     opWidth, opHeight, 0);
 
-        if (width * height * 4 > DEFAULT_EXA_SCRATCH_BFRSZ) {
-            /* Finish the rendering */
-            if (opoverY + opHeight == opY + height)
-                break;
-            /* Recalculate the Dest and Mask rendering start point */
-            srcPoint.y = srcPoint.y + F(opHeight);
-            opoverY = opoverY + opHeight;
-            if (opoverY + opHeight > opY + height)
-                opHeight = opY + height - opoverY;
-            dstOffset = GetPixmapOffset(pxDst, opoverX, opoverY);
-            maskOffset = GetSrcOffset(I(srcPoint.x), I(srcPoint.y));
+        lx_scratch_slots[slot].used = 1;
+        lx_scratch_slots[slot].marker = gp_get_command_marker();
+
+        /* Finish the rendering */
+        if (opoverY + opHeight >= opY + height)
+            break;
+
+        /* Recalculate the Dest and Mask rendering start point */
+        srcPoint.y = srcPoint.y + F(opHeight);
+        opoverY = opoverY + opHeight;
+        if (opoverY + opHeight > opY + height)
+            opHeight = opY + height - opoverY;
+        dstOffset = GetPixmapOffset(pxDst, opoverX, opoverY);
+        maskOffset = GetSrcOffset(I(srcPoint.x), I(srcPoint.y));
+    }
+}
+
+/* Scaled sources are resampled by the CPU into the scratch buffer, and
+ * blended and converted from there by the GP as usual.  The framebuffer
+ * is slow to read a pixel at a time, so each source line that is needed
+ * is first copied into system memory with a single memcpy().  Sampling
+ * follows pixman: nearest for the Nearest and Fast filters, bilinear for
+ * Good and Best.  Bilinear samples on the edge of a non repeating source
+ * use the edge pixels instead of blending in transparency. */
+
+static struct {
+    int row;
+    unsigned char *data;
+} lx_scale_rows[2];
+
+/* The column tables and the two source lines share a buffer that is kept
+ * from one call to the next, and only grows */
+
+static unsigned char *lx_scale_buffer;
+static unsigned long lx_scale_buffer_size;
+
+/* Work out the source column or line that a destination one samples,
+ * and for bilinear the one next to it and the weight (0-255) of that */
+
+static Bool
+lx_scale_sample(xFixed m, xFixed t, int d, int size, int *c0, int *c1,
+                int *w)
+{
+    long long v = (((long long) m * (((long long) d << 16) + 0x8000)) >> 16)
+        + t;
+
+    if (exaScratch.bilinear) {
+        v -= 0x8000;
+        *c0 = (int) (v >> 16);
+        *c1 = *c0 + 1;
+        *w = (int) (v >> 8) & 0xFF;
+    }
+    else {
+        *c0 = *c1 = (int) ((v - 1) >> 16);
+        *w = 0;
+    }
+
+    if (exaScratch.repeat) {
+        *c0 = ((*c0 % size) + size) % size;
+        *c1 = ((*c1 % size) + size) % size;
+        return TRUE;
+    }
+
+    if (*c1 < 0 || *c0 >= size)
+        return FALSE;
+
+    if (*c0 < 0)
+        *c0 = 0;
+    if (*c1 >= size)
+        *c1 = size - 1;
+
+    return TRUE;
+}
+
+static unsigned char *
+lx_scale_fetch_row(int row, int xmin, int bytes)
+{
+    int i = row & 1;
+
+    if (lx_scale_rows[i].row != row) {
+        memcpy(lx_scale_rows[i].data, cim_fb_ptr + exaScratch.srcOffset +
+               (row * exaScratch.srcPitch) + (xmin * exaScratch.srcBpp),
+               bytes);
+        lx_scale_rows[i].row = row;
+    }
+
+    return lx_scale_rows[i].data;
+}
+
+static void
+lx_scale_line_nearest(unsigned char *dst, const unsigned char *src,
+                      const int *cols, int width)
+{
+    int i;
+
+    switch (exaScratch.srcBpp) {
+    case 4:
+        for (i = 0; i < width; i++)
+            ((CARD32 *) dst)[i] = ((const CARD32 *) src)[cols[i]];
+        break;
+    case 2:
+        for (i = 0; i < width; i++)
+            ((CARD16 *) dst)[i] = ((const CARD16 *) src)[cols[i]];
+        break;
+    default:
+        for (i = 0; i < width; i++)
+            dst[i] = src[cols[i]];
+        break;
+    }
+}
+
+/* Interpolate all four channels of two 8888 pixels, two at a time */
+
+static inline CARD32
+lx_scale_lerp(CARD32 a, CARD32 b, int w)
+{
+    CARD32 rb = ((a & 0xFF00FF) * (256 - w) + (b & 0xFF00FF) * w) >> 8;
+    CARD32 ag = ((a >> 8) & 0xFF00FF) * (256 - w) +
+        ((b >> 8) & 0xFF00FF) * w;
+
+    return (rb & 0xFF00FF) | (ag & 0xFF00FF00);
+}
+
+static void
+lx_scale_line_bilinear(CARD32 * dst, const CARD32 * top, const CARD32 * bot,
+                       const int *cols0, const int *cols1, const int *wx,
+                       int width, int wy)
+{
+    int i;
+
+    for (i = 0; i < width; i++)
+        dst[i] = lx_scale_lerp(lx_scale_lerp(top[cols0[i]], top[cols1[i]],
+                                             wx[i]),
+                               lx_scale_lerp(bot[cols0[i]], bot[cols1[i]],
+                                             wx[i]), wy);
+}
+
+typedef void (*lx_scale_nearest_fn) (unsigned char *, const unsigned char *,
+                                     const int *, int);
+typedef void (*lx_scale_bilinear_fn) (CARD32 *, const CARD32 *,
+                                      const CARD32 *, const int *,
+                                      const int *, const int *, int, int);
+
+#if defined(__i386__) || defined(__x86_64__)
+
+/* With the MMX extensions the pixels are gathered eight bytes at a time
+ * and written to the scratch buffer with MOVNTQ, like
+ * geode_stream_to_screen() does.  The bilinear weights are applied to the
+ * four channels of a pixel at once, with the same results as
+ * lx_scale_lerp().  The caller issues the sfence and emms. */
+
+static void
+lx_scale_line_nearest_mmx(unsigned char *dst, const unsigned char *src,
+                          const int *cols, int width)
+{
+    int bpp = exaScratch.srcBpp;
+    int n = 8 / bpp;
+    int i;
+
+    union {
+        unsigned long long q;
+        CARD32 l[2];
+        CARD16 w[4];
+        unsigned char b[8];
+    } v;
+
+    for (; width > 0 && ((unsigned long) dst & 7); width--, cols++, dst += bpp)
+        lx_scale_line_nearest(dst, src, cols, 1);
+
+    for (; width >= n; width -= n, cols += n, dst += 8) {
+        switch (bpp) {
+        case 4:
+            v.l[0] = ((const CARD32 *) src)[cols[0]];
+            v.l[1] = ((const CARD32 *) src)[cols[1]];
+            break;
+        case 2:
+            for (i = 0; i < 4; i++)
+                v.w[i] = ((const CARD16 *) src)[cols[i]];
+            break;
+        default:
+            for (i = 0; i < 8; i++)
+                v.b[i] = src[cols[i]];
+            break;
+        }
+
+        __asm__ __volatile__("   movq %1, %%mm0\n"
+                             "   movntq %%mm0, (%0)\n"
+                             :
+                             :"r"(dst), "m"(v.q)
+                             :"memory", "mm0");
+    }
+
+    lx_scale_line_nearest(dst, src, cols, width);
+}
+
+/* Two pixels at a time: the four samples of each are unpacked to words,
+ * blended across with pmullw, then down, and packed back together */
+
+static void
+lx_scale_line_bilinear_mmx(CARD32 * dst, const CARD32 * top,
+                           const CARD32 * bot, const int *cols0,
+                           const int *cols1, const int *wx, int width, int wy)
+{
+    unsigned long long wv[2], wh[4];
+    CARD32 p[8];
+    int i;
+
+    wv[0] = (256 - wy) * 0x0001000100010001ULL;
+    wv[1] = wy * 0x0001000100010001ULL;
+
+    if (width > 0 && ((unsigned long) dst & 7)) {
+        lx_scale_line_bilinear(dst++, top, bot, cols0++, cols1++, wx++, 1,
+                               wy);
+        width--;
+    }
+
+    for (; width >= 2; width -= 2, dst += 2, cols0 += 2, cols1 += 2, wx += 2) {
+        for (i = 0; i < 2; i++) {
+            p[(i << 2) + 0] = top[cols0[i]];
+            p[(i << 2) + 1] = top[cols1[i]];
+            p[(i << 2) + 2] = bot[cols0[i]];
+            p[(i << 2) + 3] = bot[cols1[i]];
+            wh[(i << 1) + 0] = (256 - wx[i]) * 0x0001000100010001ULL;
+            wh[(i << 1) + 1] = wx[i] * 0x0001000100010001ULL;
+        }
+
+        __asm__ __volatile__("   pxor %%mm7, %%mm7\n"
+                             "   movd   (%0), %%mm0\n"
+                             "   movd  4(%0), %%mm1\n"
+                             "   movd  8(%0), %%mm2\n"
+                             "   movd 12(%0), %%mm3\n"
+                             "   punpcklbw %%mm7, %%mm0\n"
+                             "   punpcklbw %%mm7, %%mm1\n"
+                             "   punpcklbw %%mm7, %%mm2\n"
+                             "   punpcklbw %%mm7, %%mm3\n"
+                             "   pmullw  (%1), %%mm0\n"
+                             "   pmullw 8(%1), %%mm1\n"
+                             "   pmullw  (%1), %%mm2\n"
+                             "   pmullw 8(%1), %%mm3\n"
+                             "   paddw %%mm1, %%mm0\n"
+                             "   paddw %%mm3, %%mm2\n"
+                             "   psrlw $8, %%mm0\n"
+                             "   psrlw $8, %%mm2\n"
+                             "   pmullw  (%2), %%mm0\n"
+                             "   pmullw 8(%2), %%mm2\n"
+                             "   paddw %%mm2, %%mm0\n"
+                             "   psrlw $8, %%mm0\n"
+                             "   movd 16(%0), %%mm1\n"
+                             "   movd 20(%0), %%mm2\n"
+                             "   movd 24(%0), %%mm3\n"
+                             "   movd 28(%0), %%mm4\n"
+                             "   punpcklbw %%mm7, %%mm1\n"
+                             "   punpcklbw %%mm7, %%mm2\n"
+                             "   punpcklbw %%mm7, %%mm3\n"
+                             "   punpcklbw %%mm7, %%mm4\n"
+                             "   pmullw 16(%1), %%mm1\n"
+                             "   pmullw 24(%1), %%mm2\n"
+                             "   pmullw 16(%1), %%mm3\n"
+                             "   pmullw 24(%1), %%mm4\n"
+                             "   paddw %%mm2, %%mm1\n"
+                             "   paddw %%mm4, %%mm3\n"
+                             "   psrlw $8, %%mm1\n"
+                             "   psrlw $8, %%mm3\n"
+                             "   pmullw  (%2), %%mm1\n"
+                             "   pmullw 8(%2), %%mm3\n"
+                             "   paddw %%mm3, %%mm1\n"
+                             "   psrlw $8, %%mm1\n"
+                             "   packuswb %%mm1, %%mm0\n"
+                             "   movntq %%mm0, (%3)\n"
+                             :
+                             :"r"(p), "r"(wh), "r"(wv), "r"(dst)
+                             :"memory", "mm0", "mm1", "mm2", "mm3", "mm4",
+                             "mm7");
+    }
+
+    lx_scale_line_bilinear(dst, top, bot, cols0, cols1, wx, width, wy);
+}
+
+#endif
+
+static void
+lx_composite_scale(PixmapPtr pxDst, int srcX, int srcY, int dstX, int dstY,
+                   int width, int height)
+{
+    PictTransform *t = exaScratch.transform;
+    unsigned long dstPitch = exaGetPixmapPitch(pxDst);
+    unsigned long slotSize = exaScratch.bufferSize / LX_SCRATCH_SLOTS;
+    unsigned long slotOffset, tmpPitch;
+    int x0 = -1, x1 = 0, y0 = -1, y1 = 0;
+    int *cols0, *cols1, *wx;
+    unsigned long size;
+    int xmin, bytes, lines, slot, mmx = 0;
+    int i, j, y, n, r0, r1, wy;
+
+    lx_scale_nearest_fn nearest = lx_scale_line_nearest;
+    lx_scale_bilinear_fn bilinear = lx_scale_line_bilinear;
+
+    /* Room for the columns, and for two whole source lines */
+
+    size = (width * 3 * sizeof(int)) +
+        (exaScratch.srcWidth * exaScratch.srcBpp * 2);
+
+    if (size > lx_scale_buffer_size) {
+        free(lx_scale_buffer);
+        lx_scale_buffer_size = 0;
+
+        lx_scale_buffer = malloc(size);
+        if (lx_scale_buffer == NULL)
+            return;
+
+        lx_scale_buffer_size = size;
+    }
+
+#if defined(__i386__) || defined(__x86_64__)
+    mmx = geode_has_movntq();
+
+    if (mmx) {
+        nearest = lx_scale_line_nearest_mmx;
+        bilinear = lx_scale_line_bilinear_mmx;
+    }
+#endif
+
+    cols0 = (int *) lx_scale_buffer;
+    cols1 = cols0 + width;
+    wx = cols1 + width;
+
+    /* Sample the columns.  The scale is positive, so the columns that
+     * are inside the source are all in one piece */
+
+    for (i = 0; i < width; i++) {
+        if (lx_scale_sample(t->matrix[0][0], t->matrix[0][2], srcX + i,
+                            exaScratch.srcWidth, &cols0[i], &cols1[i],
+                            &wx[i])) {
+            if (x0 < 0)
+                x0 = i;
+            x1 = i + 1;
+        }
+    }
+
+    for (j = 0; j < height; j++) {
+        if (lx_scale_sample(t->matrix[1][1], t->matrix[1][2], srcY + j,
+                            exaScratch.srcHeight, &r0, &r1, &wy)) {
+            if (y0 < 0)
+                y0 = j;
+            y1 = j + 1;
+        }
+    }
+
+    if (x0 < 0 || y0 < 0) {
+        lx_composite_clear_outside(pxDst, dstX, dstY, width, height,
+                                   0, 0, 0, 0);
+        lx_hazard_record(0, exaGetPixmapOffset(pxDst), dstPitch,
+                         (pxDst->drawable.bitsPerPixel + 7) / 8, dstX, dstY,
+                         width, height);
+        return;
+    }
+
+    /* Only copy the part of the source lines that is used */
+
+    xmin = exaScratch.repeat ? 0 : cols0[x0];
+    bytes = ((exaScratch.repeat ? exaScratch.srcWidth : cols1[x1 - 1] + 1) -
+             xmin) * exaScratch.srcBpp;
+
+    for (i = x0; i < x1; i++) {
+        cols0[i] -= xmin;
+        cols1[i] -= xmin;
+    }
+
+    lx_scale_rows[0].data = (unsigned char *) (wx + width);
+    lx_scale_rows[1].data = lx_scale_rows[0].data + bytes;
+    lx_scale_rows[0].row = lx_scale_rows[1].row = -1;
+
+    tmpPitch = (x1 - x0) * exaScratch.srcBpp;
+    lines = slotSize / tmpPitch;
+
+    /* The GP may still be drawing to the source.  The scratch slots are
+     * waited for one at a time below. */
+
+    lx_hazard_wait(exaScratch.srcOffset, exaScratch.srcPitch,
+                   exaScratch.srcBpp, 0, 0, exaScratch.srcWidth,
+                   exaScratch.srcHeight);
+
+    for (y = y0; y < y1; y += n) {
+        n = (lines < y1 - y) ? lines : y1 - y;
+
+        slot = lx_scratch_next;
+        lx_scratch_next = (slot + 1) % LX_SCRATCH_SLOTS;
+        slotOffset = exaScratch.bufferOffset + (slot * slotSize);
+
+        if (lx_scratch_slots[slot].used)
+            gp_wait_command_marker(lx_scratch_slots[slot].marker);
+
+        for (j = 0; j < n; j++) {
+            unsigned char *dst = cim_fb_ptr + slotOffset + (j * tmpPitch);
+
+            lx_scale_sample(t->matrix[1][1], t->matrix[1][2], srcY + y + j,
+                            exaScratch.srcHeight, &r0, &r1, &wy);
+
+            if (exaScratch.bilinear)
+                (*bilinear) ((CARD32 *) dst,
+                             (CARD32 *) lx_scale_fetch_row(r0, xmin, bytes),
+                             (CARD32 *) lx_scale_fetch_row(r1, xmin, bytes),
+                             cols0 + x0, cols1 + x0, wx + x0, x1 - x0, wy);
+            else
+                (*nearest) (dst, lx_scale_fetch_row(r0, xmin, bytes),
+                            cols0 + x0, x1 - x0);
         }
+
+#if defined(__i386__) || defined(__x86_64__)
+        if (mmx)
+            __asm__ __volatile__("   sfence\n" "   emms\n":::"memory");
+#endif
+
+        lx_composite_pass(exaScratch.op,
+                          GetPixmapOffset(pxDst, dstX + x0, dstY + y),
+                          dstPitch, slotOffset, tmpPitch,
+                          exaScratch.srcFormat, x1 - x0, n, 0);
+
+        lx_scratch_slots[slot].used = 1;
+        lx_scratch_slots[slot].marker = gp_get_command_marker();
+    }
+
+    lx_composite_clear_outside(pxDst, dstX, dstY, width, height,
+                               x0, y0, x1, y1);
+
+    /* The source may be the destination too, and the next call reads it */
+
+    lx_hazard_record(0, exaGetPixmapOffset(pxDst), dstPitch,
+                     (pxDst->drawable.bitsPerPixel + 7) / 8, dstX, dstY,
+                     width, height);
+}
+
+/* Linear gradients along one of the axes have the same color along the
+ * other one, so a strip of one line or column has everything needed to
+ * draw them.  The strip is rendered by the CPU in a8r8g8b8, following
+ * pixman: each pixel is sampled at its center, and the stop colors are
+ * interpolated before they are premultiplied.  The strip is then drawn
+ * as a repeating source through lx_composite_repeat(). */
+
+static CARD32
+lx_gradient_pixel(int pos)
+{
+    PictLinearGradient *g = exaScratch.gradient;
+    PictGradientStopPtr s = g->stops;
+    xFixed p1, p2;
+    long long t;
+    unsigned int a, r, gr, b, w = 0;
+    int i;
+
+    if (exaScratch.gradientVertical) {
+        p1 = g->p1.y;
+        p2 = g->p2.y;
+    }
+    else {
+        p1 = g->p1.x;
+        p2 = g->p2.x;
+    }
+
+    t = ((((long long) pos << 16) + 0x8000 - p1) << 16) / (p2 - p1);
+
+    switch (exaScratch.gradientRepeat) {
+    case RepeatNormal:
+        t &= 0xFFFF;
+        break;
+    case RepeatPad:
+        t = t < 0 ? 0 : (t > 0x10000 ? 0x10000 : t);
+        break;
+    case RepeatReflect:
+        t &= 0x1FFFF;
+        if (t > 0x10000)
+            t = 0x20000 - t;
+        break;
+    default:
+        if (t < 0 || t > 0x10000)
+            return 0;
+        break;
+    }
+
+    for (i = 0; i < g->nstops - 1 && t >= s[i + 1].x; i++) ;
+
+    if (i < g->nstops - 1 && t > s[i].x)
+        w = ((t - s[i].x) << 8) / (s[i + 1].x - s[i].x);
+
+    a = s[i].color.alpha >> 8;
+    r = s[i].color.red >> 8;
+    gr = s[i].color.green >> 8;
+    b = s[i].color.blue >> 8;
+
+    if (w) {
+        a = (a * (256 - w) + (s[i + 1].color.alpha >> 8) * w) >> 8;
+        r = (r * (256 - w) + (s[i + 1].color.red >> 8) * w) >> 8;
+        gr = (gr * (256 - w) + (s[i + 1].color.green >> 8) * w) >> 8;
+        b = (b * (256 - w) + (s[i + 1].color.blue >> 8) * w) >> 8;
+    }
+
+    r = (r * a + 127) / 255;
+    gr = (gr * a + 127) / 255;
+    b = (b * a + 127) / 255;
+
+    return (a << 24) | (r << 16) | (gr << 8) | b;
+}
+
+static void
+lx_gradient_save(ScreenPtr pScreen, ExaOffscreenArea * area)
+{
+    struct lx_gradient *entry = area->privData;
+
+    entry->area = NULL;
+}
+
+/* Return the offset of the strip for length pixels of the gradient from
+ * start, rendering it if it isn't cached, or 0 if there is no off-screen
+ * memory for it */
+
+static unsigned long
+lx_gradient_offset(struct lx_gradient *entry)
+{
+    if (entry->area)
+        return entry->area->offset;
+
+    return entry->mem ? entry->mem->offset : 0;
+}
+
+static unsigned long
+lx_gradient_strip(ScreenPtr pScreen, int start, int length)
+{
+    GeodeRec *pGeode = GEODEPTR_FROM_SCREEN(pScreen);
+    struct lx_gradient *entry;
+    CARD32 *dst;
+    int i;
+
+    for (i = 0; i < LX_GRADIENT_CACHE; i++) {
+        entry = &lx_gradients[i];
+
+        if (lx_gradient_offset(entry) &&
+            entry->hash == exaScratch.gradientHash &&
+            entry->vertical == exaScratch.gradientVertical &&
+            entry->start == start && entry->length == length)
+            return lx_gradient_offset(entry);
+    }
+
+    entry = &lx_gradients[lx_gradient_next];
+    lx_gradient_next = (lx_gradient_next + 1) % LX_GRADIENT_CACHE;
+
+    if (entry->area) {
+        exaOffscreenFree(pScreen, entry->area);
+        entry->area = NULL;
+    }
+
+    if (entry->mem) {
+        GeodeMemUsed(pGeode, GEODE_MEM_PIXMAP, -entry->mem->size);
+        GeodeFreeOffscreen(pGeode, entry->mem);
+        entry->mem = NULL;
+    }
+
+    if (GEODE_EXA_MIXED(pGeode)) {
+        entry->mem = GeodeAllocOffscreen(pGeode, length * 4, 16);
+
+        if (entry->mem)
+            GeodeMemUsed(pGeode, GEODE_MEM_PIXMAP, entry->mem->size);
         else
-            break;
+            GeodeMemFailed(pGeode, GEODE_MEM_PIXMAP);
+    }
+    else
+        entry->area = exaOffscreenAlloc(pScreen, length * 4, 16, FALSE,
+                                        lx_gradient_save, entry);
+
+    if (!lx_gradient_offset(entry))
+        return 0;
+
+    entry->hash = exaScratch.gradientHash;
+    entry->vertical = exaScratch.gradientVertical;
+    entry->start = start;
+    entry->length = length;
+
+    /* Queued blts may still use the memory.  Those that read an older
+     * strip in it are recorded by lx_composite_gradient() */
+
+    lx_hazard_wait(lx_gradient_offset(entry), length * 4, 1, 0, 0,
+                   length * 4, 1);
+
+    dst = (CARD32 *) (cim_fb_ptr + lx_gradient_offset(entry));
+
+    for (i = 0; i < length; i++)
+        dst[i] = lx_gradient_pixel(start + i);
+
+    return lx_gradient_offset(entry);
+}
+
+static void
+lx_composite_gradient(PixmapPtr pxDst, int srcX, int srcY, int dstX,
+                      int dstY, int width, int height)
+{
+    int vertical = exaScratch.gradientVertical;
+    int start = vertical ? srcY : srcX;
+    int length = vertical ? height : width;
+    unsigned long offset;
+    int i;
+
+    offset = lx_gradient_strip(pxDst->drawable.pScreen, start, length);
+
+    if (offset) {
+        exaScratch.srcOffset = offset;
+        exaScratch.srcBpp = 4;
+        exaScratch.srcPitch = vertical ? 4 : length * 4;
+        exaScratch.srcWidth = vertical ? 1 : length;
+        exaScratch.srcHeight = vertical ? length : 1;
+
+        if ((vertical ? width : height) == 1)
+            lx_composite_onepass(pxDst, GetPixmapOffset(pxDst, dstX, dstY),
+                                 offset, width, height);
+        else if (!lx_composite_repeat(pxDst, dstX, dstY, 0, 0, width,
+                                      height))
+            offset = 0;
+    }
+
+    /* The strip is recorded as if it was written, so it isn't recycled
+     * under a blt in this run that still reads it */
+
+    if (offset) {
+        lx_hazard_record(0, offset, length * 4, 1, 0, 0, length * 4, 1);
+        return;
+    }
+
+    /* Otherwise each line of the gradient is drawn as a solid fill */
+
+    for (i = 0; i < length; i++) {
+        CARD16 red, green, blue, alpha;
+        CARD32 color = lx_gradient_pixel(start + i);
+
+        _GetRGBAFromPixel(color, &red, &green, &blue, &alpha, PICT_a8r8g8b8);
+        _GetPixelFromRGBA(&color, red, green, blue, alpha,
+                          exaScratch.dstFormat->exa);
+
+        exaScratch.srcColor = color;
+        exaScratch.srcAlpha = alpha >> 8;
+
+        if (vertical)
+            lx_composite_solid(pxDst, GetPixmapOffset(pxDst, dstX, dstY + i),
+                               width, 1);
+        else
+            lx_composite_solid(pxDst, GetPixmapOffset(pxDst, dstX + i, dstY),
+                               1, height);
     }
 }
 
@@ -1229,6 +2820,22 @@ lx_do_composite(PixmapPtr pxDst, int srcX, int srcY, int maskX,
     int opWidth = width;
     int opHeight = height;
 
+    if (exaScratch.type == COMP_TYPE_SOLID) {
+        lx_composite_solid(pxDst, GetPixmapOffset(pxDst, dstX, dstY), width,
+                           height);
+        return;
+    }
+
+    if (exaScratch.type == COMP_TYPE_SCALE) {
+        lx_composite_scale(pxDst, srcX, srcY, dstX, dstY, width, height);
+        return;
+    }
+
+    if (exaScratch.type == COMP_TYPE_GRADIENT) {
+        lx_composite_gradient(pxDst, srcX, srcY, dstX, dstY, width, height);
+        return;
+    }
+
     /* Transform the source coordinates */
 
     if (exaScratch.type == COMP_TYPE_MASK) {
@@ -1271,6 +2878,38 @@ lx_do_composite(PixmapPtr pxDst, int srcX, int srcY, int maskX,
 
     transformPoint(exaScratch.transform, &srcPoint);
 
+    if (exaScratch.type == COMP_TYPE_ONEPASS ||
+        exaScratch.type == COMP_TYPE_TWOPASS) {
+        Bool add_a8 = (exaScratch.op == PictOpAdd &&
+                       exaScratch.srcFormat->exa == PICT_a8 &&
+                       exaScratch.dstFormat->exa == PICT_a8);
+
+        if (!exaScratch.repeat) {
+            lx_composite_bounded(pxDst, dstX, dstY, I(srcPoint.x),
+                                 I(srcPoint.y), width, height);
+            return;
+        }
+
+        /* Small repeating sources are expanded first, and then drawn in a
+         * few large blts.  Otherwise the source is drawn tile by tile */
+
+        if (exaScratch.type == COMP_TYPE_ONEPASS && !add_a8) {
+            if (!lx_composite_repeat(pxDst, dstX, dstY, I(srcPoint.x),
+                                     I(srcPoint.y), width, height))
+                lx_composite_onepass_special(pxDst, width, height, dstX, dstY,
+                                             I(srcPoint.x), I(srcPoint.y));
+            return;
+        }
+
+        /* Start the repeat from within the source */
+
+        srcPoint.x = F(((I(srcPoint.x) % (int) exaScratch.srcWidth) +
+                        (int) exaScratch.srcWidth) % (int) exaScratch.srcWidth);
+        srcPoint.y = F(((I(srcPoint.y) % (int) exaScratch.srcHeight) +
+                        (int) exaScratch.srcHeight) %
+                       (int) exaScratch.srcHeight);
+    }
+
     /* Adjust the point to fit into the pixmap */
 
     if (I(srcPoint.x) < 0) {
@@ -1306,82 +2945,12 @@ lx_do_composite(PixmapPtr pxDst, int srcX, int srcY, int maskX,
             opHeight = exaScratch.srcHeight - maskY;
     }
     else {
-        if (exaScratch.type == COMP_TYPE_ONEPASS) {
-            /* This is the condition srcX or/and srcY is/are out of source
-             * region */
-            if (((srcY >= 0 && srcY >= exaScratch.srcHeight)
-                 || (srcX >= 0 && srcX >= exaScratch.srcWidth)) &&
-                (exaScratch.op == PictOpOver || exaScratch.op == PictOpSrc)) {
-                if (exaScratch.repeat == 1) {
-                    opWidth = width;
-                    opHeight = height;
-                }
-                else {
-                    if (exaScratch.op == PictOpOver)
-                        return;
-                    else {
-                        exaScratch.op = PictOpClear;
-                        opWidth = width;
-                        opHeight = height;
-                    }
-                }
-                /* This is the condition srcX or/and srcY is/are in the source
-                 * region */
-            }
-            else if (srcX >= 0 && srcY >= 0 &&
-                     (exaScratch.op == PictOpOver ||
-                      exaScratch.op == PictOpSrc)) {
-                if (exaScratch.repeat == 1) {
-                    opWidth = width;
-                    opHeight = height;
-                }
-                else {
-                    if ((exaScratch.srcWidth - srcX) < opWidth)
-                        opWidth = exaScratch.srcWidth - srcX;
-                    if ((exaScratch.srcHeight - srcY) < opHeight)
-                        opHeight = exaScratch.srcHeight - srcY;
-                }
-                /* This is the condition srcX or/and srcY is/are negative */
-            }
-            else if ((srcX < 0 || srcY < 0) &&
-                     (exaScratch.op == PictOpOver ||
-                      exaScratch.op == PictOpSrc)) {
-                if (exaScratch.repeat == 1) {
-                    opWidth = width;
-                    opHeight = height;
-                }
-                else {
-                    /* FIXME: We can't support negative srcX/Y for all corner cases in
-                     * a sane way without a bit bigger refactoring. So as to avoid
-                     * gross misrenderings (e.g missing tray icons) in current real-world
-                     * applications, just shift destination appropriately for now and
-                     * ignore out of bounds source pixmap zero-vector handling. This is
-                     * actually correct for PictOpOver, but PictOpSrc out of bounds regions
-                     * should be blacked out, but aren't - without this workaround however
-                     * it'd be simply all black instead, which is probably worse till a full
-                     * clean solution solves it for all cases. */
-                    if (srcX < 0) {
-                        opX -= srcX;
-                        srcX = 0;
-                    }
-
-                    if (srcY < 0) {
-                        opY -= srcY;
-                        srcY = 0;
-                    }
-
-                    /* EXA has taken care of adjusting srcWidth if it gets cut on the right */
-                    width = opWidth = exaScratch.srcWidth;
-                    /* EXA has taken care of adjusting srcHeight if it gets cut on the bottom */
-                    height = opHeight = exaScratch.srcHeight;
-                }
-            }
-            else {
-                if (exaScratch.srcWidth < opWidth)
-                    opWidth = exaScratch.srcWidth;
-                if (exaScratch.srcHeight < opHeight)
-                    opHeight = exaScratch.srcHeight;
-            }
+        if (exaScratch.type == COMP_TYPE_ONEPASS ||
+            exaScratch.type == COMP_TYPE_TWOPASS) {
+            if ((exaScratch.srcWidth - I(srcPoint.x)) < opWidth)
+                opWidth = exaScratch.srcWidth - I(srcPoint.x);
+            if ((exaScratch.srcHeight - I(srcPoint.y)) < opHeight)
+                opHeight = exaScratch.srcHeight - I(srcPoint.y);
         }
         else {
             if (exaScratch.rotate == RR_Rotate_180) {
@@ -1402,7 +2971,10 @@ lx_do_composite(PixmapPtr pxDst, int srcX, int srcY, int maskX,
         switch (exaScratch.type) {
 
         case COMP_TYPE_MASK:{
-            if (exaScratch.op == PictOpOver || exaScratch.op ==
+            if (exaScratch.solidMask)
+                lx_do_composite_mask_solid(pxDst, dstOffset, srcOffset,
+                                           opWidth, opHeight);
+            else if (exaScratch.op == PictOpOver || exaScratch.op ==
                 PictOpOutReverse || exaScratch.op == PictOpInReverse ||
                 exaScratch.op == PictOpIn || exaScratch.op == PictOpOut ||
                 exaScratch.op == PictOpOverReverse)
@@ -1416,26 +2988,17 @@ lx_do_composite(PixmapPtr pxDst, int srcX, int srcY, int maskX,
             break;
 
         case COMP_TYPE_ONEPASS:
-            if ((exaScratch.op == PictOpOver || exaScratch.op == PictOpSrc)
-                && (exaScratch.repeat == 1)) {
-                lx_composite_onepass_special(pxDst, opWidth, opHeight, opX, opY,
-                                             srcX, srcY);
-                return;
-            }
-            else if ((exaScratch.op == PictOpAdd) && (exaScratch.srcFormat->exa
-                                                      == PICT_a8) &&
-                     (exaScratch.dstFormat->exa == PICT_a8))
-                lx_composite_onepass_add_a8(pxDst, dstOffset, srcOffset,
-                                            opWidth, opHeight, opX, opY, srcX,
-                                            srcY);
-            else
-                lx_composite_onepass(pxDst, dstOffset, srcOffset, opWidth,
-                                     opHeight);
+            /* Only a repeating PictOpAdd between a8 pictures gets here */
+            lx_composite_onepass_add_a8(pxDst, dstOffset, srcOffset,
+                                        opWidth, opHeight, opX, opY,
+                                        (opX == dstX) ? I(srcPoint.x) : 0,
+                                        (opY == dstY) ? I(srcPoint.y) : 0);
             break;
 
         case COMP_TYPE_TWOPASS:
             lx_composite_multipass(pxDst, dstOffset, srcOffset, opWidth,
                                    opHeight);
+            break;
 
         case COMP_TYPE_ROTATE:
             lx_composite_rotate(pxDst, dstOffset, srcOffset, opWidth, opHeight);
@@ -1461,94 +3024,272 @@ lx_do_composite(PixmapPtr pxDst, int srcX, int srcY, int maskX,
                 ? (exaScratch.srcWidth - maskX) : (dstX + width) - opX;
             opHeight = ((dstY + height) - opY) > (exaScratch.srcHeight - maskY)
                 ? (exaScratch.srcHeight - maskY) : (dstY + height) - opY;
-            /* All black out of the mask */
-            if (!exaScratch.maskrepeat)
+            /* All black out of the mask, which leaves the destination
+             * alone when blending over it */
+            if (!exaScratch.maskrepeat) {
+                if (exaScratch.solidMask)
+                    break;
                 exaScratch.srcColor = 0x0;
+            }
+        }
+        else if (exaScratch.type == COMP_TYPE_ONEPASS ||
+                 exaScratch.type == COMP_TYPE_TWOPASS) {
+            /* Only the first tile of a row or column starts part way into
+             * the repeating source */
+            int sx = (opX == dstX) ? I(srcPoint.x) : 0;
+            int sy = (opY == dstY) ? I(srcPoint.y) : 0;
+
+            opWidth = ((dstX + width) - opX) > (exaScratch.srcWidth - sx)
+                ? (exaScratch.srcWidth - sx) : (dstX + width) - opX;
+            opHeight = ((dstY + height) - opY) > (exaScratch.srcHeight - sy)
+                ? (exaScratch.srcHeight - sy) : (dstY + height) - opY;
+            srcOffset = GetSrcOffset(sx, sy);
         }
         else {
-            if (exaScratch.type == COMP_TYPE_ONEPASS) {
-                if (srcX >= 0 && srcY >= 0 && (exaScratch.op == PictOpOver ||
-                                               exaScratch.op == PictOpSrc ||
-                                               exaScratch.op == PictOpClear)) {
-                    opWidth =
-                        ((dstX + width) - opX) >
-                        (exaScratch.srcWidth - srcX) ? (exaScratch.srcWidth -
-                                                        srcX) : (dstX + width)
-                        - opX;
-                    opHeight = ((dstY + height) - opY) >
-                        (exaScratch.srcHeight - srcY) ?
-                        (exaScratch.srcHeight - srcY) : (dstY + height) - opY;
-                }
-                else {
-                    opWidth = ((dstX + width) - opX) > exaScratch.srcWidth ?
-                        exaScratch.srcWidth : (dstX + width) - opX;
-                    opHeight = ((dstY + height) - opY) > exaScratch.srcHeight ?
-                        exaScratch.srcHeight : (dstY + height) - opY;
-                }
-            }
-            else {
-                opWidth = ((dstX + width) - opX) > (exaScratch.srcWidth - srcY)
-                    ? (exaScratch.srcWidth - srcY) : (dstX + width) - opX;
-                opHeight =
-                    ((dstY + height) - opY) >
-                    (exaScratch.srcHeight - srcX) ? (exaScratch.srcHeight -
-                                                     srcX) : (dstY + height) -
-                    opY;
-            }
-            /* All black out of the source */
-            if (!exaScratch.repeat && (exaScratch.type == COMP_TYPE_ONEPASS)) {
-                /* FIXME: We black out the source here, so that any further regions
-                 * in the loop get handled as a source that's a zero-vector (as
-                 * defined for out-of-bounds from source pixmap for RepeatModeNone),
-                 * but this will likely interfere with cases where srcX and/or srcY
-                 * is negative - as opposed to e.g width being larger than srcWidth,
-                 * which is exercised in rendercheck (always rectangle in top-left
-                 * corner).
-                 * Additionally it forces the drawing into tiles of srcWidth/srcHeight
-                 * for non-repeat modes too, where we don't really need to tile it like
-                 * this and could draw the out of bound regions all at once (or at most
-                 * in 4 operations without the big loop). */
-                lx_composite_all_black(srcOffset, exaScratch.srcWidth,
-                                       exaScratch.srcHeight);
-            }
+            opWidth = ((dstX + width) - opX) > (exaScratch.srcWidth - srcY)
+                ? (exaScratch.srcWidth - srcY) : (dstX + width) - opX;
+            opHeight =
+                ((dstY + height) - opY) >
+                (exaScratch.srcHeight - srcX) ? (exaScratch.srcHeight -
+                                                 srcX) : (dstY + height) - opY;
             if (!exaScratch.repeat && (exaScratch.type == COMP_TYPE_ROTATE))
                 break;
         }
     }
 }
 
+static int
+lx_mark_sync(ScreenPtr pScreen)
+{
+    return (int) gp_get_command_marker();
+}
+
 static void
 lx_wait_marker(ScreenPtr PScreen, int marker)
 {
-    gp_wait_until_idle();
+    gp_wait_command_marker((unsigned long) marker);
 }
 
 static void
 lx_done(PixmapPtr ptr)
 {
+    gp_flush_command_buffer();
 }
 
-#if 0
 static void
+lx_done_composite(PixmapPtr ptr)
+{
+    lx_hazard_record_all();
+    gp_flush_command_buffer();
+}
+
+/* Uploads smaller than this are sent through the command buffer with
+ * gp_color_bitmap_to_screen_blt, which queues behind the blts already in
+ * flight instead of stalling.  Larger uploads are copied directly with
+ * streaming stores, which suit the write-combined frame buffer and avoid
+ * writing every byte twice */
+
+#define LX_UPLOAD_BLT_LIMIT 16384
+
+static Bool
 lx_upload_to_screen(PixmapPtr pxDst, int x, int y, int w, int h,
                     char *src, int src_pitch)
 {
     GeodeRec *pGeode = GEODEPTR_FROM_PIXMAP(pxDst);
     int dst_pitch = exaGetPixmapPitch(pxDst);
-    int cpp = (pxDst->drawable.bitsPerPixel + 7) / 8;
+    int bpp = pxDst->drawable.bitsPerPixel;
+    int cpp = (bpp + 7) / 8;
+    unsigned int offset = exaGetPixmapOffset(pxDst);
+    unsigned int dst = offset + (y * dst_pitch) + (x * cpp);
 
-    char *dst;
-    int offset = exaGetPixmapOffset(pxDst);
+    if (bpp < 8)
+        return FALSE;
 
-    dst = (char *) (pGeode->FBBase + offset + (y * dst_pitch) + (x * cpp));
-    int i;
+    if (bpp != 24 && w * h * cpp < LX_UPLOAD_BLT_LIMIT) {
+        gp_declare_blt(0);
+        gp_set_bpp(bpp);
+        gp_set_raster_operation(0xCC);
+        gp_set_strides(dst_pitch, src_pitch);
+        gp_color_bitmap_to_screen_blt(dst, 0, w, h, (unsigned char *) src,
+                                      src_pitch);
+
+        lx_hazard_record(0, offset, dst_pitch, cpp, x, y, w, h);
+        return TRUE;
+    }
+
+    /* The hazard ring only holds the last few destinations, and nothing
+     * that queued blts still read from, so wait for all of them */
+
+    gp_wait_command_marker(gp_get_command_marker());
+
+    geode_stream_to_screen((unsigned char *) src, pGeode->FBBase + dst,
+                           src_pitch, dst_pitch, w * cpp, h);
+    return TRUE;
+}
+
+/* The frame buffer is not cached, so reads are done a line at a time with
+ * string moves rather than pixel by pixel */
+
+static Bool
+lx_download_from_screen(PixmapPtr pxSrc, int x, int y, int w, int h,
+                        char *dst, int dst_pitch)
+{
+    GeodeRec *pGeode = GEODEPTR_FROM_PIXMAP(pxSrc);
+    int src_pitch = exaGetPixmapPitch(pxSrc);
+    int bpp = pxSrc->drawable.bitsPerPixel;
+    int cpp = (bpp + 7) / 8;
+    unsigned int offset = exaGetPixmapOffset(pxSrc);
+    unsigned int src = offset + (y * src_pitch) + (x * cpp);
+
+    if (bpp < 8)
+        return FALSE;
+
+    /* Only wait for the queued blts that write to the area */
+
+    lx_hazard_wait(offset, src_pitch, cpp, x, y, w, h);
+
+    geode_memory_to_screen_blt((unsigned long) (pGeode->FBBase + src),
+                               (unsigned long) dst, src_pitch, dst_pitch,
+                               w, h, bpp);
+    return TRUE;
+}
+
+#ifdef EXA_MIXED_PIXMAPS
+
+/* With mixed pixmaps EXA keeps new pixmaps in system memory, and only asks
+ * for video memory when the GP is going to draw with them.  That memory
+ * comes from the offscreen list, up to what the driver's own buffers need
+ * to be left, see LXAllocPixmapMem().  The screen and the rotation shadow
+ * are attached to memory that the driver already owns, with
+ * LXExaAttachPixmap(). */
+
+struct lx_pixmap {
+    GeodeMemPtr mem;            /* NULL for attached memory */
+    unsigned int offset;
+    Bool offscreen;
+};
+
+static void *
+lx_create_pixmap2(ScreenPtr pScreen, int width, int height, int depth,
+                  int usage_hint, int bitsPerPixel, int *new_fb_pitch)
+{
+    GeodeRec *pGeode = GEODEPTR_FROM_SCREEN(pScreen);
+    struct lx_pixmap *priv;
+    int pitch;
+
+    priv = calloc(1, sizeof(*priv));
 
-    for (i = 0; i < h; i++) {
-        memcpy(dst, src, w * cpp);
-        dst += dst_pitch;
-        src += src_pitch;
+    if (priv == NULL)
+        return NULL;
+
+    if (width <= 0 || height <= 0 || bitsPerPixel <= 0)
+        return priv;
+
+    /* Glyph pictures and the like are only drawn by the CPU */
+
+    switch (usage_hint) {
+    case 0:
+    case CREATE_PIXMAP_USAGE_SCRATCH:
+    case CREATE_PIXMAP_USAGE_BACKING_PIXMAP:
+        break;
+
+    default:
+        free(priv);
+        return NULL;
+    }
+
+    pitch = (((width * bitsPerPixel + 7) / 8) + 31) & ~31;
+    priv->mem = LXAllocPixmapMem(pGeode, pitch * height, 32);
+
+    /* EXA keeps the pixmap in system memory, and tries again the next
+     * time it is used by the GP */
+
+    if (priv->mem == NULL) {
+        GeodeMemFailed(pGeode, GEODE_MEM_PIXMAP);
+        free(priv);
+        return NULL;
+    }
+
+    GeodeMemUsed(pGeode, GEODE_MEM_PIXMAP, priv->mem->size);
+    priv->offset = priv->mem->offset;
+    priv->offscreen = TRUE;
+
+    *new_fb_pitch = pitch;
+    return priv;
+}
+
+static void
+lx_destroy_pixmap(ScreenPtr pScreen, void *driverPriv)
+{
+    GeodeRec *pGeode = GEODEPTR_FROM_SCREEN(pScreen);
+    struct lx_pixmap *priv = driverPriv;
+
+    /* The offscreen list is already gone for the pixmaps that live until
+     * the screen is closed */
+
+    if (priv->mem && pGeode->offscreenList) {
+        GeodeMemUsed(pGeode, GEODE_MEM_PIXMAP, -priv->mem->size);
+        GeodeFreeOffscreen(pGeode, priv->mem);
     }
+
+    free(priv);
+}
+
+static Bool
+lx_modify_pixmap_header(PixmapPtr pPixmap, int width, int height, int depth,
+                        int bitsPerPixel, int devKind, pointer pPixData)
+{
+    GeodeRec *pGeode = GEODEPTR_FROM_PIXMAP(pPixmap);
+    struct lx_pixmap *priv = exaGetPixmapDriverPrivate(pPixmap);
+
+    /* Pixmaps with their own data are left to EXA */
+
+    if (priv == NULL || !priv->offscreen || pPixData)
+        return FALSE;
+
+    return miModifyPixmapHeader(pPixmap, width, height, depth, bitsPerPixel,
+                                devKind, pGeode->FBBase + priv->offset);
+}
+
+/* The CPU draws on small pixmaps in a copy in system memory, which is
+ * cached.  EXA makes that copy when this fails, and only writes back what
+ * was drawn on it once the GP uses the pixmap again.  Larger pixmaps and
+ * the screen are accessed in video memory rather than being copied back
+ * and forth. */
+
+#define LX_SHADOW_LIMIT (64 * 1024)
+
+static Bool
+lx_prepare_access(PixmapPtr pPixmap, int index)
+{
+    struct lx_pixmap *priv = exaGetPixmapDriverPrivate(pPixmap);
+
+    return !(priv && priv->mem && priv->mem->size <= LX_SHADOW_LIMIT);
+}
+
+Bool
+LXExaAttachPixmap(PixmapPtr pPixmap, unsigned int offset, int pitch)
+{
+    ScreenPtr pScreen = pPixmap->drawable.pScreen;
+    struct lx_pixmap *priv = exaGetPixmapDriverPrivate(pPixmap);
+
+    if (priv == NULL || priv->mem)
+        return FALSE;
+
+    priv->offset = offset;
+    priv->offscreen = TRUE;
+
+    return (*pScreen->ModifyPixmapHeader) (pPixmap, 0, 0, 0, 0, pitch, NULL);
+}
+
+#else
+
+Bool
+LXExaAttachPixmap(PixmapPtr pPixmap, unsigned int offset, int pitch)
+{
+    return FALSE;
 }
+
 #endif
 
 #if EXA_VERSION_MAJOR > 2 || (EXA_VERSION_MAJOR == 2 && EXA_VERSION_MINOR >= 2)
@@ -1563,6 +3304,14 @@ lx_exa_pixmap_is_offscreen(PixmapPtr pPixmap)
         (void *) (pGeode->FBBase + pGeode->offscreenStart +
                   pGeode->offscreenSize);
 
+#ifdef EXA_MIXED_PIXMAPS
+    if (GEODE_EXA_MIXED(pGeode)) {
+        struct lx_pixmap *priv = exaGetPixmapDriverPrivate(pPixmap);
+
+        return priv != NULL && priv->offscreen;
+    }
+#endif
+
     if ((void *) pPixmap->devPrivate.ptr >= start &&
         (void *) pPixmap->devPrivate.ptr < end)
         return TRUE;
@@ -1582,8 +3331,15 @@ LXExaInit(ScreenPtr pScreen)
     pExa->exa_major = EXA_VERSION_MAJOR;
     pExa->exa_minor = EXA_VERSION_MINOR;
 
+    pExa->MarkSync = lx_mark_sync;
     pExa->WaitMarker = lx_wait_marker;
 
+    gp_set_command_batching(LX_CMD_BATCH_LIMIT);
+
+    /* Gradient strips from an earlier server generation are gone */
+    memset(lx_gradients, 0, sizeof(lx_gradients));
+    LXExaResetFallbacks();
+
     pExa->PrepareSolid = lx_prepare_solid;
     pExa->Solid = lx_do_solid;
     pExa->DoneSolid = lx_done;
@@ -1596,13 +3352,23 @@ LXExaInit(ScreenPtr pScreen)
     pExa->CheckComposite = lx_check_composite;
     pExa->PrepareComposite = lx_prepare_composite;
     pExa->Composite = lx_do_composite;
-    pExa->DoneComposite = lx_done;
-    //pExa->UploadToScreen =  lx_upload_to_screen;
+    pExa->DoneComposite = lx_done_composite;
+    pExa->UploadToScreen = lx_upload_to_screen;
+    pExa->DownloadFromScreen = lx_download_from_screen;
 
 #if EXA_VERSION_MAJOR > 2 || (EXA_VERSION_MAJOR == 2 && EXA_VERSION_MINOR >= 2)
     pExa->PixmapIsOffscreen = lx_exa_pixmap_is_offscreen;
 #endif
 
+#ifdef EXA_MIXED_PIXMAPS
+    if (pExa->flags & EXA_MIXED_PIXMAPS) {
+        pExa->CreatePixmap2 = lx_create_pixmap2;
+        pExa->DestroyPixmap = lx_destroy_pixmap;
+        pExa->ModifyPixmapHeader = lx_modify_pixmap_header;
+        pExa->PrepareAccess = lx_prepare_access;
+    }
+#endif
+
     //pExa->flags = EXA_OFFSCREEN_PIXMAPS;
 
     return exaDriverInit(pScreen, pGeode->pExa);
@@ -26,44 +26,94 @@
 #include "config.h"
 #endif
 
+#include <string.h>             /* memset() */
+
 #include "xf86.h"
 #include "geode.h"
+#include "xf86Crtc.h"
 #include "cim/cim_regs.h"
 
 #define ALIGN(x,y)   (((x) + (y) - 1) / (y) * (y))
 #define LX_CB_PITCH   544
 
+/* Three 720x576 YUY2 frames for the video overlay */
+#define LX_VIDEO_RESERVE (720 * 2 * 576 * 3)
+
 /* Geode offscreen memory allocation functions.  This is
    overengineered for the simple hardware that we have, but
    there are multiple functions that may want to independently
    allocate and free memory (crtc->shadow_alloc and Xv).  This
    provides a semi-robust mechanism for doing that.
+
+   The offscreen memory is split into blocks, used and free, that
+   are kept on a list in address order, so a block that is freed is
+   merged with free neighbours right away.  Free blocks are also kept
+   on one of GEODE_MEM_BINS lists by the power of two of their size.
+   An allocation only looks at the bins that can hold it, starting
+   with the smallest, and is placed at the first aligned offset that
+   fits in the block.  Nodes of blocks that went away are kept for
+   reuse instead of being freed.
 */
 
-/* Return the number of free bytes */
+static int
+GeodeMemBin(unsigned int size)
+{
+    int bin = 0;
 
-unsigned int
-GeodeOffscreenFreeSize(GeodeRec * pGeode)
+    while ((size >>= 1) && bin < GEODE_MEM_BINS - 1)
+        bin++;
+
+    return bin;
+}
+
+static void
+GeodeMemBinInsert(GeodeRec * pGeode, GeodeMemPtr ptr)
 {
-    GeodeMemPtr ptr = pGeode->offscreenList;
+    int bin = GeodeMemBin(ptr->size);
 
-    if (ptr == NULL)
-        return pGeode->offscreenSize;
+    ptr->isFree = TRUE;
+    ptr->freePrev = NULL;
+    ptr->freeNext = pGeode->offscreenBins[bin];
+
+    if (ptr->freeNext)
+        ptr->freeNext->freePrev = ptr;
 
-    for (; ptr->next; ptr = ptr->next);
-    return (pGeode->offscreenStart + pGeode->offscreenSize)
-        - (ptr->offset + ptr->size);
+    pGeode->offscreenBins[bin] = ptr;
 }
 
-void
-GeodeFreeOffscreen(GeodeRec * pGeode, GeodeMemPtr ptr)
+static void
+GeodeMemBinRemove(GeodeRec * pGeode, GeodeMemPtr ptr)
+{
+    if (ptr->freePrev)
+        ptr->freePrev->freeNext = ptr->freeNext;
+    else
+        pGeode->offscreenBins[GeodeMemBin(ptr->size)] = ptr->freeNext;
+
+    if (ptr->freeNext)
+        ptr->freeNext->freePrev = ptr->freePrev;
+
+    ptr->isFree = FALSE;
+}
+
+static GeodeMemPtr
+GeodeMemNode(GeodeRec * pGeode)
 {
-    /* There is a clear memory leak here, but
-     * but it is unlikely that the first block of
-     * "allocated" memory is going to be released
-     * individually.
-     */
+    GeodeMemPtr ptr = pGeode->offscreenSpare;
+
+    if (ptr == NULL)
+        return calloc(1, sizeof(*ptr));
+
+    pGeode->offscreenSpare = ptr->next;
+    memset(ptr, 0, sizeof(*ptr));
+
+    return ptr;
+}
+
+/* Take a block off the address list, and keep its node for later */
 
+static void
+GeodeMemUnlink(GeodeRec * pGeode, GeodeMemPtr ptr)
+{
     if (ptr->prev == NULL)
         pGeode->offscreenList = ptr->next;
     else
@@ -72,42 +122,156 @@ GeodeFreeOffscreen(GeodeRec * pGeode, GeodeMemPtr ptr)
     if (ptr->next)
         ptr->next->prev = ptr->prev;
 
-    free(ptr);
+    ptr->next = pGeode->offscreenSpare;
+    pGeode->offscreenSpare = ptr;
+}
+
+/* Put a new node on the address list after ptr, or first if ptr is NULL */
+
+static void
+GeodeMemLink(GeodeRec * pGeode, GeodeMemPtr ptr, GeodeMemPtr nptr)
+{
+    nptr->prev = ptr;
+    nptr->next = ptr ? ptr->next : pGeode->offscreenList;
+
+    if (nptr->next)
+        nptr->next->prev = nptr;
+
+    if (ptr)
+        ptr->next = nptr;
+    else
+        pGeode->offscreenList = nptr;
+}
+
+/* Start out with all of the offscreen memory in one free block */
+
+static Bool
+GeodeMemInit(GeodeRec * pGeode)
+{
+    GeodeMemPtr ptr;
+
+    if (pGeode->offscreenSize == 0 || (ptr = GeodeMemNode(pGeode)) == NULL)
+        return FALSE;
+
+    ptr->offset = pGeode->offscreenStart;
+    ptr->size = pGeode->offscreenSize;
+
+    GeodeMemLink(pGeode, NULL, ptr);
+    GeodeMemBinInsert(pGeode, ptr);
+
+    pGeode->offscreenFree = pGeode->offscreenSize;
+    return TRUE;
+}
+
+/* Use size bytes at offset of the free block ptr, and give what is left
+   before and after it back to the bins */
+
+static GeodeMemPtr
+GeodeMemCarve(GeodeRec * pGeode, GeodeMemPtr ptr, unsigned int offset,
+              int size)
+{
+    GeodeMemPtr lead = NULL, tail = NULL;
+    unsigned int end = ptr->offset + ptr->size;
+
+    if (offset > ptr->offset && (lead = GeodeMemNode(pGeode)) == NULL)
+        return NULL;
+
+    if (offset + size < end && (tail = GeodeMemNode(pGeode)) == NULL) {
+        if (lead) {
+            lead->next = pGeode->offscreenSpare;
+            pGeode->offscreenSpare = lead;
+        }
+
+        return NULL;
+    }
+
+    GeodeMemBinRemove(pGeode, ptr);
+
+    if (lead) {
+        lead->offset = ptr->offset;
+        lead->size = offset - ptr->offset;
+
+        GeodeMemLink(pGeode, ptr->prev, lead);
+        GeodeMemBinInsert(pGeode, lead);
+    }
+
+    if (tail) {
+        tail->offset = offset + size;
+        tail->size = end - tail->offset;
+
+        GeodeMemLink(pGeode, ptr, tail);
+        GeodeMemBinInsert(pGeode, tail);
+    }
+
+    ptr->offset = offset;
+    ptr->size = size;
+    pGeode->offscreenFree -= size;
+
+    return ptr;
+}
+
+/* Return the number of free bytes */
+
+unsigned int
+GeodeOffscreenFreeSize(GeodeRec * pGeode)
+{
+    if (pGeode->offscreenList == NULL)
+        return pGeode->offscreenSize;
+
+    return pGeode->offscreenFree;
+}
+
+void
+GeodeFreeOffscreen(GeodeRec * pGeode, GeodeMemPtr ptr)
+{
+    GeodeMemPtr prev = ptr->prev, next = ptr->next;
+
+    pGeode->offscreenFree += ptr->size;
+
+    if (prev && prev->isFree) {
+        GeodeMemBinRemove(pGeode, prev);
+        prev->size += ptr->size;
+
+        GeodeMemUnlink(pGeode, ptr);
+        ptr = prev;
+    }
+
+    if (next && next->isFree) {
+        GeodeMemBinRemove(pGeode, next);
+        ptr->size += next->size;
+
+        GeodeMemUnlink(pGeode, next);
+    }
+
+    GeodeMemBinInsert(pGeode, ptr);
 }
 
 /* Allocate the "rest" of the offscreen memory - this is for
    situations where we have very little video memory, and we
-   want to take as much of it as we can for EXA
+   want to take as much of it as we can for EXA.  This is the
+   largest free block.
 */
 
 static GeodeMemPtr
 GeodeAllocRemainder(GeodeRec * pGeode)
 {
-    GeodeMemPtr nptr, ptr = pGeode->offscreenList;
+    GeodeMemPtr ptr, best = NULL;
+    int bin;
 
-    if (!pGeode->offscreenList) {
-        pGeode->offscreenList = calloc(1, sizeof(*nptr));
-        pGeode->offscreenList->offset = pGeode->offscreenStart;
-        pGeode->offscreenList->size = pGeode->offscreenSize;
-        pGeode->offscreenList->next = NULL;
-        pGeode->offscreenList->prev = NULL;
+    if (pGeode->offscreenList == NULL && !GeodeMemInit(pGeode))
+        return NULL;
 
-        return pGeode->offscreenList;
+    for (bin = GEODE_MEM_BINS - 1; bin >= 0 && best == NULL; bin--) {
+        for (ptr = pGeode->offscreenBins[bin]; ptr; ptr = ptr->freeNext) {
+            if (best == NULL || ptr->size > best->size)
+                best = ptr;
+        }
     }
 
-    /* Go to the end of the list of allocated stuff */
-    for (; ptr->next; ptr = ptr->next);
-
-    nptr = calloc(1, sizeof(*nptr));
-    nptr->offset = ptr->offset + ptr->size;
-    nptr->size = pGeode->offscreenSize -
-        (nptr->offset - pGeode->offscreenStart);
+    if (best == NULL)
+        return NULL;
 
-    nptr->next = ptr->next;
-    nptr->prev = ptr;
-    ptr->next = nptr;
-
-    return nptr;
+    return GeodeMemCarve(pGeode, best, best->offset, best->size);
 }
 
 /* Allocate 'size' bytes of offscreen memory.
@@ -116,56 +280,221 @@ GeodeAllocRemainder(GeodeRec * pGeode)
 GeodeMemPtr
 GeodeAllocOffscreen(GeodeRec * pGeode, int size, int align)
 {
-    GeodeMemPtr ptr = pGeode->offscreenList;
-    GeodeMemPtr nptr;
-
+    GeodeMemPtr ptr;
     unsigned int offset;
+    int bin;
+
+    if (size <= 0)
+        return NULL;
+
+    if (pGeode->offscreenList == NULL && !GeodeMemInit(pGeode))
+        return NULL;
+
+    for (bin = GeodeMemBin(size); bin < GEODE_MEM_BINS; bin++) {
+        for (ptr = pGeode->offscreenBins[bin]; ptr; ptr = ptr->freeNext) {
+            offset = ALIGN(ptr->offset, align);
+
+            if (offset + size <= ptr->offset + ptr->size)
+                return GeodeMemCarve(pGeode, ptr, offset, size);
+        }
+    }
+
+    return NULL;
+}
+
+/* Allocate video memory for the driver's own buffers, such as the video
+   overlay and the rotation shadow.  While EXA manages the off-screen
+   pixmaps it hands out this memory too, so it can move pixmaps out of
+   the way.  With mixed pixmaps, or without EXA at all, it comes from the
+   offscreen list like the pixmaps do.
+*/
+
+static GeodeMemPtr
+lx_alloc_video_mem(ScrnInfoPtr pScrni, int size, int align, int owner)
+{
+    GeodeRec *pGeode = GEODEPTR(pScrni);
+    ExaOffscreenArea *area;
+    GeodeMemPtr ptr;
 
-    if (!pGeode->offscreenList) {
+    if (pGeode->NoAccel || GEODE_EXA_MIXED(pGeode)) {
+        ptr = GeodeAllocOffscreen(pGeode, size, align);
 
-        if (size > pGeode->offscreenSize)
+        if (ptr == NULL)
             return NULL;
+    }
+    else {
+        area = exaOffscreenAlloc(pScrni->pScreen, size, align, TRUE, NULL,
+                                 NULL);
+
+        if (area == NULL)
+            return NULL;
+
+        ptr = calloc(1, sizeof(*ptr));
+
+        if (ptr == NULL) {
+            exaOffscreenFree(pScrni->pScreen, area);
+            return NULL;
+        }
+
+        ptr->offset = area->offset;
+        ptr->size = area->size;
+        ptr->area = area;
+    }
+
+    ptr->owner = owner;
+    GeodeMemUsed(pGeode, owner, ptr->size);
+
+    return ptr;
+}
+
+/* Turn compression off and give its buffer back */
 
-        offset = ALIGN(pGeode->offscreenStart, align);
+static void
+lx_release_compression(ScrnInfoPtr pScrni)
+{
+    GeodeRec *pGeode = GEODEPTR(pScrni);
 
-        pGeode->offscreenList = calloc(1, sizeof(*nptr));
-        pGeode->offscreenList->offset = offset;
-        pGeode->offscreenList->size = size;
-        pGeode->offscreenList->next = NULL;
+    /* Let the display controller finish the frame it is reading the
+       buffer for before somebody else draws over it */
 
-        return pGeode->offscreenList;
+    if (pScrni->vtSema && pGeode->Compression) {
+        vg_set_compression_enable(0);
+        vg_wait_vertical_blank();
     }
 
-    while (ptr) {
-        unsigned int gap;
+    pGeode->Compression = FALSE;
+
+    if (pGeode->compressionArea != NULL) {
+        LXFreeVideoMem(pScrni, pGeode->compressionArea);
+        pGeode->compressionArea = NULL;
+    }
+}
+
+GeodeMemPtr
+LXAllocVideoMem(ScrnInfoPtr pScrni, int size, int align, int owner)
+{
+    GeodeRec *pGeode = GEODEPTR(pScrni);
+    GeodeMemPtr ptr;
+
+    ptr = lx_alloc_video_mem(pScrni, size, align, owner);
 
-        if (ptr->next == NULL)
-            gap = pGeode->offscreenSize + pGeode->offscreenStart;
+    /* Compression is only an optimization, so its buffer is the first
+       thing to go when memory runs out.  The next re-plan takes it back
+       if there is room */
 
-        else
-            gap = ptr->next->offset;
+    if (ptr == NULL && pGeode->compressionArea != NULL) {
+        lx_release_compression(pScrni);
+        ptr = lx_alloc_video_mem(pScrni, size, align, owner);
+    }
 
-        gap = gap - (ptr->offset + ptr->size);
-        gap = ALIGN(gap, align);
+    if (ptr == NULL)
+        GeodeMemFailed(pGeode, owner);
 
-        if (size < gap) {
-            offset = ptr->offset + ptr->size;
-            offset = ALIGN(ptr->offset + ptr->size, align);
+    return ptr;
+}
 
-            nptr = calloc(1, sizeof(*nptr));
-            nptr->offset = offset;
-            nptr->size = size;
-            nptr->next = ptr->next;
-            nptr->prev = ptr;
-            ptr->next = nptr;
+/* Allocate video memory the caller can do without, such as the extra
+   buffers of the video overlay, so compression keeps its buffer */
+
+GeodeMemPtr
+LXTryAllocVideoMem(ScrnInfoPtr pScrni, int size, int align, int owner)
+{
+    return lx_alloc_video_mem(pScrni, size, align, owner);
+}
+
+void
+LXFreeVideoMem(ScrnInfoPtr pScrni, GeodeMemPtr ptr)
+{
+    GeodeRec *pGeode = GEODEPTR(pScrni);
+
+    GeodeMemUsed(pGeode, ptr->owner, -ptr->size);
+
+    if (ptr->area == NULL) {
+        GeodeFreeOffscreen(pGeode, ptr);
+        return;
+    }
+
+    exaOffscreenFree(pScrni->pScreen, ptr->area);
+    free(ptr);
+}
+
+/* Allocate video memory for a pixmap with mixed pixmaps.  The driver's own
+   buffers are only allocated when they are used, so the pixmaps leave
+   enough free for the video overlay, the rotation shadow and the
+   compression buffer that aren't there yet.  A pixmap that doesn't fit
+   stays in system memory.
+*/
+
+GeodeMemPtr
+LXAllocPixmapMem(GeodeRec * pGeode, int size, int align)
+{
+    unsigned int reserve = 0;
+
+    if (pGeode->memStats.used[GEODE_MEM_VIDEO] == 0)
+        reserve += LX_VIDEO_RESERVE;
+
+    if (pGeode->shadowArea == NULL)
+        reserve += pGeode->displaySize;
+
+    if (pGeode->tryCompression && pGeode->compressionArea == NULL)
+        reserve += (pGeode->displaySize / pGeode->Pitch) * LX_CB_PITCH;
+
+    if (GeodeOffscreenFreeSize(pGeode) < size + reserve)
+        return NULL;
+
+    return GeodeAllocOffscreen(pGeode, size, align);
+}
+
+/* Re-plan the memory the driver holds on to after a mode set, a rotation
+   change or the video going away.  The compression buffer is only kept
+   while the CRTC is running, and is sized for the current mode rather
+   than the virtual screen, so the rest goes to the pixmaps.
+*/
 
-            return nptr;
+void
+LXUpdateOffscreen(ScrnInfoPtr pScrni)
+{
+    GeodeRec *pGeode = GEODEPTR(pScrni);
+    xf86CrtcConfigPtr config = XF86_CRTC_CONFIG_PTR(pScrni);
+    xf86CrtcPtr crtc = config->crtc[0];
+    int size = 0;
+
+    /* EXA owns the memory in the classic layout, so only re-plan while it
+       is up and the hardware is ours */
+    if (pGeode->starting || !pScrni->vtSema)
+        return;
+
+    if (pGeode->tryCompression && crtc->enabled)
+        size = crtc->mode.VDisplay * LX_CB_PITCH;
+
+    if (pGeode->compressionArea != NULL &&
+        pGeode->compressionArea->size != size)
+        lx_release_compression(pScrni);
+
+    if (size == 0)
+        return;
+
+    if (pGeode->compressionArea == NULL) {
+        /* The compression buffer needs to be 16 byte aligned */
+        pGeode->compressionArea = lx_alloc_video_mem(pScrni, size, 16,
+                                                     GEODE_MEM_COMPRESSION);
+
+        if (pGeode->compressionArea == NULL) {
+            GeodeMemFailed(pGeode, GEODE_MEM_COMPRESSION);
+            xf86DrvMsg(pScrni->scrnIndex, X_INFO,
+                       "Not enough memory for compression\n");
+            return;
         }
 
-        ptr = ptr->next;
+        pGeode->CBData.compression_offset = pGeode->compressionArea->offset;
+        pGeode->CBData.size = LX_CB_PITCH;
+        pGeode->CBData.pitch = LX_CB_PITCH;
     }
 
-    return NULL;
+    pGeode->Compression = TRUE;
+
+    vg_configure_compression(&(pGeode->CBData));
+    vg_set_compression_enable(1);
 }
 
 /* Carve out the space for the visible screen, and carve out
@@ -190,26 +519,11 @@ LXInitOffscreen(ScrnInfoPtr pScrni)
     pGeode->offscreenStart = pGeode->displaySize;
     pGeode->offscreenSize = fbavail - pGeode->displaySize;
 
-    /* Allocate the usual memory suspects */
-    if (pGeode->tryCompression) {
-        int size = pScrni->virtualY * LX_CB_PITCH;
+    memset(&pGeode->memStats, 0, sizeof(pGeode->memStats));
+    GeodeMemSetUsed(pGeode, GEODE_MEM_DISPLAY, pGeode->displaySize);
 
-        /* The compression buffer needs to be 16 byte aligned */
-        ptr = GeodeAllocOffscreen(pGeode, size, 16);
-
-        if (ptr != NULL) {
-            pGeode->CBData.compression_offset = ptr->offset;
-            pGeode->CBData.size = LX_CB_PITCH;
-            pGeode->CBData.pitch = LX_CB_PITCH;
-
-            pGeode->Compression = TRUE;
-        }
-        else {
-            xf86DrvMsg(pScrni->scrnIndex, X_ERROR,
-                       "Not enough memory for compression\n");
-            pGeode->Compression = FALSE;
-        }
-    }
+    /* Allocate the usual memory suspects.  The compression buffer is
+       left to LXUpdateOffscreen(), which only holds it while it is used */
 
     if (pGeode->tryHWCursor) {
         ptr = GeodeAllocOffscreen(pGeode,
@@ -219,11 +533,13 @@ LXInitOffscreen(ScrnInfoPtr pScrni)
         if (ptr != NULL) {
             pGeode->CursorStartOffset = ptr->offset;
             pGeode->HWCursor = TRUE;
+            GeodeMemSetUsed(pGeode, GEODE_MEM_CURSOR, ptr->size);
         }
         else {
             xf86DrvMsg(pScrni->scrnIndex, X_ERROR,
                        "Not enough memory for the hardware cursor\n");
             pGeode->HWCursor = FALSE;
+            GeodeMemFailed(pGeode, GEODE_MEM_CURSOR);
         }
     }
 
@@ -235,68 +551,140 @@ LXInitOffscreen(ScrnInfoPtr pScrni)
 
         if (pGeode->exaBfrSz > 0) {
             ptr = GeodeAllocOffscreen(pGeode, pGeode->exaBfrSz, 4);
-            if (ptr != NULL)
+            if (ptr != NULL) {
                 pGeode->exaBfrOffset = ptr->offset;
+                GeodeMemSetUsed(pGeode, GEODE_MEM_SCRATCH, ptr->size);
+            }
+            else
+                GeodeMemFailed(pGeode, GEODE_MEM_SCRATCH);
         }
 
         pGeode->pExa->offScreenBase = 0;
         pGeode->pExa->memorySize = 0;
 
-        /* This might cause complaints - in order to avoid using
-           xorg.conf as much as possible, we make assumptions about
-           what a "default" memory map would look like.  After
-           discussion, we agreed that the default driver should assume
-           the user will want to use rotation and video overlays, and
-           EXA will get whatever is leftover. 
-         */
+        /* With mixed pixmaps the rest of the memory stays in the
+         * offscreen list, and the pixmaps are allocated from there */
 
-        /* Get the amount of offscreen memory still left */
-        size = GeodeOffscreenFreeSize(pGeode);
+        if (!GEODE_EXA_MIXED(pGeode)) {
+            /* This might cause complaints - in order to avoid using
+               xorg.conf as much as possible, we make assumptions about
+               what a "default" memory map would look like.  After
+               discussion, we agreed that the default driver should assume
+               the user will want to use rotation and video overlays, and
+               EXA will get whatever is leftover. 
+             */
 
-        /* Align the size to a K boundary */
-        size &= ~1023;
+            /* Get the amount of offscreen memory still left */
+            size = GeodeOffscreenFreeSize(pGeode);
 
-        /* Allocate the EXA offscreen space */
-        ptr = GeodeAllocOffscreen(pGeode, size, 4);
+            /* Align the size to a K boundary */
+            size &= ~1023;
 
-        if (ptr == NULL) {
-            /* If we couldn't allocate what we wanted,
-             * then allocate whats left */
+            /* Allocate the EXA offscreen space */
+            ptr = GeodeAllocOffscreen(pGeode, size, 4);
 
-            ptr = GeodeAllocRemainder(pGeode);
-        }
+            if (ptr == NULL) {
+                /* If we couldn't allocate what we wanted,
+                 * then allocate whats left */
 
-        if (ptr != NULL) {
-            pGeode->pExa->offScreenBase = ptr->offset;
-            pGeode->pExa->memorySize = ptr->offset + ptr->size;
+                ptr = GeodeAllocRemainder(pGeode);
+            }
+
+            if (ptr != NULL) {
+                pGeode->pExa->offScreenBase = ptr->offset;
+                pGeode->pExa->memorySize = ptr->offset + ptr->size;
+                GeodeMemSetUsed(pGeode, GEODE_MEM_EXA, ptr->size);
+            }
         }
     }
 
     /* Show the memory map for diagnostic purposes */
+    LXDumpVideoMem(pScrni);
+}
 
-    xf86DrvMsg(pScrni->scrnIndex, X_INFO, "LX video memory:\n");
-    xf86DrvMsg(pScrni->scrnIndex, X_INFO, " Display: 0x%x bytes\n",
-               pGeode->displaySize);
+/* Write the memory map to the log: what each owner holds now and at its
+   peak, how many of its allocations failed, and how broken up the free
+   offscreen memory is.  This is also available at run time through the
+   VIDEO_MEMORY output property.  In the classic EXA layout the pixmaps,
+   and the driver buffers that come from EXA, are inside the EXA pool.
+   The free space in the pool is shown on a line of its own.
+*/
 
-    if (pGeode->Compression)
-        xf86DrvMsg(pScrni->scrnIndex, X_INFO, " Compression: 0x%x bytes\n",
-                   pScrni->virtualY * LX_CB_PITCH);
+static void
+lx_dump_exa_pool(ScrnInfoPtr pScrni)
+{
+    GeodeRec *pGeode = GEODEPTR(pScrni);
+    ExaOffscreenArea *area;
+    unsigned int avail = 0, largest = 0, run = 0;
+    int blocks = 0;
+
+    for (area = pGeode->pExa->offScreenAreas; area; area = area->next) {
+        if (area->state != ExaOffscreenAvail) {
+            run = 0;
+            continue;
+        }
 
-    if (pGeode->HWCursor)
-        xf86DrvMsg(pScrni->scrnIndex, X_INFO, " Cursor: 0x%x bytes\n",
-                   LX_CURSOR_HW_WIDTH * 4 * LX_CURSOR_HW_HEIGHT);
+        /* Neighbouring free areas are one block */
+        if (run == 0)
+            blocks++;
 
-    if (pGeode->exaBfrSz)
-        xf86DrvMsg(pScrni->scrnIndex, X_INFO, " ExaBfrSz: 0x%x bytes\n",
-                   pGeode->exaBfrSz);
+        run += area->size;
+        avail += area->size;
 
-    if (pGeode->pExa && pGeode->pExa->offScreenBase)
-        xf86DrvMsg(pScrni->scrnIndex, X_INFO, " EXA: 0x%x bytes\n",
-                   (unsigned int) (pGeode->pExa->memorySize -
-                                   pGeode->pExa->offScreenBase));
+        if (run > largest)
+            largest = run;
+    }
 
-    xf86DrvMsg(pScrni->scrnIndex, X_INFO, " FREE: 0x%x bytes\n",
-               GeodeOffscreenFreeSize(pGeode));
+    xf86DrvMsg(pScrni->scrnIndex, X_INFO,
+               " EXA POOL FREE: 0x%x bytes in %d blocks, largest 0x%x "
+               "(%d%% fragmented)\n",
+               avail, blocks, largest,
+               avail ? (int) (100 - (largest * 100ULL) / avail) : 0);
+}
+
+void
+LXDumpVideoMem(ScrnInfoPtr pScrni)
+{
+    GeodeRec *pGeode = GEODEPTR(pScrni);
+    unsigned int avail, largest = 0;
+    int bin, blocks = 0;
+    GeodeMemPtr ptr;
+    Bool pool;
+
+    for (bin = 0; bin < GEODE_MEM_BINS; bin++) {
+        for (ptr = pGeode->offscreenBins[bin]; ptr; ptr = ptr->freeNext) {
+            if (ptr->size > largest)
+                largest = ptr->size;
+            blocks++;
+        }
+    }
+
+    avail = GeodeOffscreenFreeSize(pGeode);
+
+    /* An untouched list is one block */
+    if (pGeode->offscreenList == NULL && avail) {
+        largest = avail;
+        blocks = 1;
+    }
+
+    xf86DrvMsg(pScrni->scrnIndex, X_INFO, "LX video memory: 0x%x bytes\n",
+               pGeode->FBAvail);
+
+    GeodeMemDumpStats(pScrni);
+
+    /* The pool only exists once EXA has been set up */
+    pool = !pGeode->NoAccel && pGeode->pExa && !GEODE_EXA_MIXED(pGeode) &&
+        pGeode->pExa->memorySize;
+
+    xf86DrvMsg(pScrni->scrnIndex, X_INFO,
+               " FREE: 0x%x bytes in %d blocks, largest 0x%x "
+               "(%d%% fragmented)%s\n",
+               avail, blocks, largest,
+               avail ? (int) (100 - (largest * 100ULL) / avail) : 0,
+               pool ? ", outside the EXA pool" : "");
+
+    if (pool && pGeode->pExa->offScreenAreas)
+        lx_dump_exa_pool(pScrni);
 }
 
 /* Called as we go down, so blitz everybody */
@@ -305,14 +693,20 @@ void
 GeodeCloseOffscreen(ScrnInfoPtr pScrni)
 {
     GeodeRec *pGeode = GEODEPTR(pScrni);
-    GeodeMemPtr ptr = pGeode->offscreenList;
-    GeodeMemPtr nptr;
+    GeodeMemPtr ptr, nptr;
+
+    for (ptr = pGeode->offscreenList; ptr; ptr = nptr) {
+        nptr = ptr->next;
+        free(ptr);
+    }
 
-    while (ptr) {
+    for (ptr = pGeode->offscreenSpare; ptr; ptr = nptr) {
         nptr = ptr->next;
         free(ptr);
-        ptr = nptr;
     }
 
     pGeode->offscreenList = NULL;
+    pGeode->offscreenSpare = NULL;
+    pGeode->offscreenFree = 0;
+    memset(pGeode->offscreenBins, 0, sizeof(pGeode->offscreenBins));
 }
@@ -42,6 +42,8 @@ typedef struct _LXOutputPrivateRec {
 } LXOutputPrivateRec, *LXOutputPrivatePtr;
 
 static Atom scale_atom;
+static Atom fallbacks_atom;
+static Atom video_memory_atom;
 
 static void
 lx_create_resources(xf86OutputPtr output)
@@ -51,6 +53,50 @@ lx_create_resources(xf86OutputPtr output)
     ScrnInfoPtr pScrni = output->scrn;
     GeodeRec *pGeode = GEODEPTR(pScrni);
 
+    /* Setting this to "dump" writes the EXA composite fallback counters
+     * to the log, and "reset" clears them */
+
+    fallbacks_atom = MAKE_ATOM("EXA_FALLBACKS");
+    ret = RRConfigureOutputProperty(output->randr_output,
+                                    fallbacks_atom, FALSE, FALSE, FALSE, 0,
+                                    NULL);
+
+    if (ret) {
+        xf86DrvMsg(pScrni->scrnIndex, X_ERROR,
+                   "RRConfigureOutputProperty error %d\n", ret);
+    }
+
+    s = "dump";
+    ret = RRChangeOutputProperty(output->randr_output, fallbacks_atom,
+                                 XA_STRING, 8, PropModeReplace, strlen(s),
+                                 (pointer) s, FALSE, FALSE);
+
+    if (ret) {
+        xf86DrvMsg(pScrni->scrnIndex, X_ERROR,
+                   "RRCharOutputProperty error %d\n", ret);
+    }
+
+    /* Likewise for the video memory map and its counters */
+
+    video_memory_atom = MAKE_ATOM("VIDEO_MEMORY");
+    ret = RRConfigureOutputProperty(output->randr_output,
+                                    video_memory_atom, FALSE, FALSE, FALSE, 0,
+                                    NULL);
+
+    if (ret) {
+        xf86DrvMsg(pScrni->scrnIndex, X_ERROR,
+                   "RRConfigureOutputProperty error %d\n", ret);
+    }
+
+    ret = RRChangeOutputProperty(output->randr_output, video_memory_atom,
+                                 XA_STRING, 8, PropModeReplace, strlen(s),
+                                 (pointer) s, FALSE, FALSE);
+
+    if (ret) {
+        xf86DrvMsg(pScrni->scrnIndex, X_ERROR,
+                   "RRCharOutputProperty error %d\n", ret);
+    }
+
     /* Scaling is only used for panels */
 
     if (!(pGeode->Output & OUTPUT_PANEL))
@@ -86,14 +132,36 @@ lx_output_set_property(xf86OutputPtr output, Atom property,
     char *s;
     int ret;
 
-    if (property != scale_atom)
-        return FALSE;
-
     if (value->type != XA_STRING || value->format != 8)
         return FALSE;
 
     s = (char *) value->data;
 
+    if (property == fallbacks_atom) {
+        if (value->size == 4 && !strncmp("dump", s, 4))
+            LXExaDumpFallbacks(pScrni);
+        else if (value->size == 5 && !strncmp("reset", s, 5))
+            LXExaResetFallbacks();
+        else
+            return FALSE;
+
+        return TRUE;
+    }
+
+    if (property == video_memory_atom) {
+        if (value->size == 4 && !strncmp("dump", s, 4))
+            LXDumpVideoMem(pScrni);
+        else if (value->size == 5 && !strncmp("reset", s, 5))
+            GeodeMemResetStats(pGeode);
+        else
+            return FALSE;
+
+        return TRUE;
+    }
+
+    if (property != scale_atom)
+        return FALSE;
+
     if (value->size == 2 && !strncmp("on", s, 2))
         pGeode->Scale = TRUE;
     else if (value->size == 3 && !strncmp("off", s, 3))
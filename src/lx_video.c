@@ -25,7 +25,6 @@
 
 /* TODO:
    Add rotation
-   Add back in double buffering?
 
 */
 
@@ -60,6 +59,18 @@
 #define CLIENT_VIDEO_ON	0x04
 #define TIMER_MASK      (OFF_TIMER | FREE_TIMER)
 
+/* The number of frames the overlay is buffered with, if the memory is
+   there.  A new frame is always written to a buffer that isn't on the
+   screen, and made visible by a flip that the display latches at the
+   next vertical blank. */
+#define LX_VIDEO_BUFFERS	3
+
+/* Planes smaller than this go through the GP command buffer, where the
+   upload queues behind the rendering in flight.  Bigger ones are copied
+   straight into the buffer with streaming stores, which moves each byte
+   over the memory bus once instead of twice. */
+#define LX_VIDEO_STREAM_LIMIT	32768
+
 #define MAKE_ATOM(a) MakeAtom(a, sizeof(a) - 1, TRUE)
 #ifndef ARRAY_SIZE
 #define ARRAY_SIZE(a) (sizeof((a)) / (sizeof(*(a))))
@@ -98,11 +109,27 @@ static XF86ImageRec Images[] = {
     XVIMAGE_Y800,
     XVIMAGE_I420,
     XVIMAGE_YV12,
+    XVIMAGE_NV12,
+    XVIMAGE_NV21,
     XVIMAGE_RGB565
 };
 
 typedef struct {
-    ExaOffscreenArea *vidmem;
+    GeodeMemPtr vidmem;
+    int bufSize;                /* The buffers in vidmem, and their size */
+    int numBufs;
+    int curBuf;                 /* The buffer last written to */
+    int flipBuf;                /* The buffer last given to the display */
+    int scanBuf;                /* The buffer the display is known to show */
+    Bool bufBusy[LX_VIDEO_BUFFERS];     /* A GP upload may be in flight */
+    unsigned long bufMarker[LX_VIDEO_BUFFERS];  /* The last GP upload to each */
+    unsigned long yExtra, uvExtra;      /* Clipped off the top */
+
+    /* A frame waiting for its upload to retire before it is shown */
+    Bool flipPending;
+    unsigned long flipY, flipU, flipV;
+    OsTimerPtr flipTimer;
+
     RegionRec clip;
     CARD32 filter;
     CARD32 colorKey;
@@ -116,19 +143,46 @@ typedef struct {
 #define GET_PORT_PRIVATE(pScrni) \
    (GeodePortPrivRec *)((GEODEPTR(pScrni))->adaptor->pPortPrivates[0].ptr)
 
+/* Wait for the GP to finish writing the current buffer, if it was the
+   last to write it.  Only the marker of a buffer that is still busy is
+   looked at, as an old marker can look outstanding until the GP idles. */
+
 static void
-LXCopyFromSys(GeodeRec * pGeode, unsigned char *src, unsigned int dst,
-              int dstPitch, int srcPitch, int h, int w)
+LXWaitVideoBuffer(GeodePortPrivRec * pPriv)
 {
+    if (pPriv->bufBusy[pPriv->curBuf]) {
+        gp_wait_command_marker(pPriv->bufMarker[pPriv->curBuf]);
+        pPriv->bufBusy[pPriv->curBuf] = FALSE;
+    }
+}
+
+static void
+LXCopyFromSys(GeodeRec * pGeode, GeodePortPrivRec * pPriv,
+              unsigned char *src, unsigned int dst, int dstPitch,
+              int srcPitch, int h, int w)
+{
+    int bpp = (srcPitch / w) << 3;
+
+    if (w * (bpp >> 3) * h >= LX_VIDEO_STREAM_LIMIT) {
+        /* The GP may still have an older frame queued for this buffer */
+        LXWaitVideoBuffer(pPriv);
+
+        geode_stream_to_screen(src, pGeode->FBBase + dst, srcPitch,
+                               dstPitch, w * (bpp >> 3), h);
+        return;
+    }
 
     gp_declare_blt(0);
-    gp_set_bpp((srcPitch / w) << 3);
+    gp_set_bpp(bpp);
 
     gp_set_raster_operation(0xCC);
     gp_set_strides(dstPitch, srcPitch);
     gp_set_solid_pattern(0);
 
     gp_color_bitmap_to_screen_blt(dst, 0, w, h, src, srcPitch);
+
+    pPriv->bufMarker[pPriv->curBuf] = gp_get_command_marker();
+    pPriv->bufBusy[pPriv->curBuf] = TRUE;
 }
 
 static void
@@ -192,24 +246,131 @@ struct {
 static Bool
 LXAllocateVidMem(ScrnInfoPtr pScrni, GeodePortPrivRec * pPriv, int size)
 {
-    if (!pPriv->vidmem || pPriv->vidmem->size < size) {
+    int n;
+
+    /* Keep every buffer as aligned as the first */
+    size = (size + 31) & ~31;
+
+    if (!pPriv->vidmem || pPriv->bufSize < size) {
         if (pPriv->vidmem) {
-            exaOffscreenFree(pScrni->pScreen, pPriv->vidmem);
+            /* Let the GP finish with the old buffers before they go */
+            for (n = 0; n < pPriv->numBufs; n++)
+                if (pPriv->bufBusy[n])
+                    gp_wait_command_marker(pPriv->bufMarker[n]);
+
+            LXFreeVideoMem(pScrni, pPriv->vidmem);
             pPriv->vidmem = NULL;
         }
 
-        pPriv->vidmem = exaOffscreenAlloc(pScrni->pScreen, size, 4,
-                                          TRUE, NULL, NULL);
+        /* Settle for fewer buffers, down to the single buffer that the
+         * display is drawn from while it is written.  Compression only
+         * gives up its memory when even that doesn't fit */
+
+        for (n = LX_VIDEO_BUFFERS; n > 1; n--) {
+            pPriv->vidmem = LXTryAllocVideoMem(pScrni, size * n, 4,
+                                               GEODE_MEM_VIDEO);
+
+            if (pPriv->vidmem != NULL)
+                break;
+        }
+
+        if (pPriv->vidmem == NULL)
+            pPriv->vidmem = LXAllocVideoMem(pScrni, size, 4, GEODE_MEM_VIDEO);
 
         if (pPriv->vidmem == NULL) {
             ErrorF("Could not allocate memory for the video\n");
             return FALSE;
         }
+
+        pPriv->bufSize = size;
+        pPriv->numBufs = n;
+        pPriv->curBuf = pPriv->numBufs - 1;
+        pPriv->flipBuf = -1;
+        pPriv->scanBuf = -1;
+        pPriv->flipPending = FALSE;
+
+        for (n = 0; n < LX_VIDEO_BUFFERS; n++)
+            pPriv->bufBusy[n] = FALSE;
     }
 
     return TRUE;
 }
 
+/* Give the display the pending frame once the GP has written it, or
+   right away after waiting for it when wait is set.  The display
+   latches the offsets at the next vertical blank, so the switch is
+   never seen half way down the screen.  Returns FALSE while the frame
+   is still being uploaded. */
+
+static Bool
+LXCommitFlip(GeodePortPrivRec * pPriv, Bool wait)
+{
+    if (!pPriv->flipPending)
+        return TRUE;
+
+    if (!wait && pPriv->bufBusy[pPriv->curBuf] &&
+        !gp_test_command_marker(pPriv->bufMarker[pPriv->curBuf]))
+        return FALSE;
+
+    LXWaitVideoBuffer(pPriv);
+
+    df_set_video_offsets(0, pPriv->flipY, pPriv->flipU, pPriv->flipV);
+    df_set_video_offsets(1, pPriv->flipY, pPriv->flipU, pPriv->flipV);
+
+    pPriv->flipBuf = pPriv->curBuf;
+    pPriv->flipPending = FALSE;
+
+    return TRUE;
+}
+
+/* Check back on a pending frame every millisecond until it is shown */
+
+static CARD32
+LXFlipTimer(OsTimerPtr timer, CARD32 now, pointer arg)
+{
+    ScrnInfoPtr pScrni = arg;
+    GeodePortPrivRec *pPriv = GET_PORT_PRIVATE(pScrni);
+
+    if (!pScrni->vtSema) {
+        pPriv->flipPending = FALSE;
+        return 0;
+    }
+
+    return LXCommitFlip(pPriv, FALSE) ? 0 : 1;
+}
+
+/* Return the offset of the buffer the next frame goes into.  A frame
+   still waiting for its upload is shown first, so it isn't lost.  The
+   new frame then goes to the buffer after it, unless the display is
+   still scanning that one out because the last flip hasn't been latched
+   yet.  With three buffers that only happens with more than one frame
+   per refresh, and the one after is free.  With two it is the buffer
+   just flipped to, which isn't on the screen yet either.  Nothing waits
+   for the vertical blank.
+*/
+
+static unsigned int
+LXNextVideoBuffer(GeodePortPrivRec * pPriv)
+{
+    int buf;
+
+    if (pPriv->numBufs == 1)
+        return pPriv->vidmem->offset;
+
+    LXCommitFlip(pPriv, TRUE);
+
+    if (!df_test_video_flip_status())
+        pPriv->scanBuf = pPriv->flipBuf;
+
+    buf = (pPriv->curBuf + 1) % pPriv->numBufs;
+
+    if (buf == pPriv->scanBuf)
+        buf = (buf + 1) % pPriv->numBufs;
+
+    pPriv->curBuf = buf;
+    return pPriv->vidmem->offset + buf * pPriv->bufSize;
+}
+
 static Bool
 LXCopyPlanar(ScrnInfoPtr pScrni, int id, unsigned char *buf,
              short x1, short y1, short x2, short y2,
@@ -224,7 +385,7 @@ LXCopyPlanar(ScrnInfoPtr pScrni, int id, unsigned char *buf,
     unsigned int USrcOffset, UDstOffset;
     unsigned int VSrcOffset, VDstOffset;
 
-    unsigned int size, lines, top, left, pixels;
+    unsigned int size, lines, top, left, pixels, base;
 
     YSrcPitch = (width + 3) & ~3;
     YDstPitch = (width + 31) & ~31;
@@ -246,6 +407,8 @@ LXCopyPlanar(ScrnInfoPtr pScrni, int id, unsigned char *buf,
         return FALSE;
     }
 
+    base = LXNextVideoBuffer(pPriv);
+
     /* The top of the source region we want to copy */
     top = y1 & ~1;
 
@@ -267,23 +430,44 @@ LXCopyPlanar(ScrnInfoPtr pScrni, int id, unsigned char *buf,
 
     lines = ((y2 + 1) & ~1) - top;
 
+    /* The CPU writes the chroma of NV formats, so wait for any older
+     * frame in this buffer before queueing the Y blt, rather than for
+     * the Y blt itself afterwards */
+
+    if (id == FOURCC_NV12 || id == FOURCC_NV21)
+        LXWaitVideoBuffer(pPriv);
+
     /* Copy Y */
 
-    LXCopyFromSys(pGeode, buf + YSrcOffset,
-                  pPriv->vidmem->offset + YDstOffset, YDstPitch, YSrcPitch,
-                  lines, pixels);
+    LXCopyFromSys(pGeode, pPriv, buf + YSrcOffset,
+                  base + YDstOffset, YDstPitch, YSrcPitch, lines, pixels);
 
-    /* Copy U + V at the same time */
+    if (id == FOURCC_NV12 || id == FOURCC_NV21) {
+        unsigned char *src = buf + (YSrcPitch * (height + (top >> 1))) + left;
+        unsigned char *u = pGeode->FBBase + base + UDstOffset;
+        unsigned char *v = pGeode->FBBase + base + VDstOffset;
 
-    LXCopyFromSys(pGeode, buf + USrcOffset,
-                  pPriv->vidmem->offset + UDstOffset, UVDstPitch, UVSrcPitch,
-                  lines, pixels >> 1);
+        /* The display has no interleaved chroma format, so split the
+         * pairs into the U and V planes on the way in */
 
-    videoScratch.dstOffset = pPriv->vidmem->offset + YDstOffset;
+        if (id == FOURCC_NV12)
+            GeodeSplitChroma(src, u, v, YSrcPitch, UVDstPitch,
+                             lines >> 1, pixels >> 1);
+        else
+            GeodeSplitChroma(src, v, u, YSrcPitch, UVDstPitch,
+                             lines >> 1, pixels >> 1);
+    }
+    else
+        /* Copy U + V at the same time */
+        LXCopyFromSys(pGeode, pPriv, buf + USrcOffset,
+                      base + UDstOffset, UVDstPitch, UVSrcPitch,
+                      lines, pixels >> 1);
+
+    videoScratch.dstOffset = base + YDstOffset;
     videoScratch.dstPitch = YDstPitch;
     videoScratch.UVPitch = UVDstPitch;
-    videoScratch.UDstOffset = pPriv->vidmem->offset + UDstOffset;
-    videoScratch.VDstOffset = pPriv->vidmem->offset + VDstOffset;
+    videoScratch.UDstOffset = base + UDstOffset;
+    videoScratch.VDstOffset = base + VDstOffset;
 
     return TRUE;
 }
@@ -322,24 +506,24 @@ LXCopyPacked(ScrnInfoPtr pScrni, int id, unsigned char *buf,
     srcOffset = (top * srcPitch) + left;
 
     /* Calculate the destination offset */
-    dstOffset = pPriv->vidmem->offset + (top * dstPitch) + left;
+    dstOffset = LXNextVideoBuffer(pPriv) + (top * dstPitch) + left;
 
     /* Make the copy happen */
 
     if (id == FOURCC_Y800) {
 
-        /* Use the shared (unaccelerated) greyscale copy - you could probably
-         * accelerate it using a 2 pass blit and patterns, but it doesn't really
-         * seem worth it
+        /* Use the shared greyscale copy - the GP can't spread the luma out
+         * to every other byte, so this is written by the CPU
          */
 
+        LXWaitVideoBuffer(pPriv);
         GeodeCopyGreyscale(buf + srcOffset, pGeode->FBBase + dstOffset,
                            srcPitch, dstPitch, height, pixels >> 1);
     }
     else
         /* FIXME: should lines be used here instead of height? */
-        LXCopyFromSys(pGeode, buf + srcOffset, dstOffset, dstPitch, srcPitch,
-                      height, pixels);
+        LXCopyFromSys(pGeode, pPriv, buf + srcOffset, dstOffset, dstPitch,
+                      srcPitch, height, pixels);
 
     videoScratch.dstOffset = dstOffset;
     videoScratch.dstPitch = dstPitch;
@@ -347,20 +531,70 @@ LXCopyPacked(ScrnInfoPtr pScrni, int id, unsigned char *buf,
     return TRUE;
 }
 
+/* Work out where the visible part of the frame in videoScratch starts */
+
+static void
+LXVideoOffsets(GeodePortPrivRec * pPriv, int id,
+               DF_VIDEO_SOURCE_PARAMS * vSrcParams)
+{
+    vSrcParams->y_offset = videoScratch.dstOffset + pPriv->yExtra;
+
+    switch (id) {
+    case FOURCC_Y800:
+    case FOURCC_I420:
+    case FOURCC_NV12:
+    case FOURCC_NV21:
+        vSrcParams->u_offset = videoScratch.UDstOffset + pPriv->uvExtra;
+        vSrcParams->v_offset = videoScratch.VDstOffset + pPriv->uvExtra;
+        break;
+    case FOURCC_YV12:
+        vSrcParams->v_offset = videoScratch.UDstOffset + pPriv->uvExtra;
+        vSrcParams->u_offset = videoScratch.VDstOffset + pPriv->uvExtra;
+        break;
+
+    default:
+        vSrcParams->u_offset = vSrcParams->v_offset = 0;
+        break;
+    }
+}
+
+/* Show a new frame in the same place as the last one, as soon as the
+   GP has uploaded it.  The server doesn't wait for that, a timer picks
+   the frame up if the upload is still queued behind other rendering.
+   A frame the CPU wrote is already there, and is shown right away. */
+
+static void
+LXFlipVideo(ScrnInfoPtr pScrni, GeodePortPrivRec * pPriv, int id)
+{
+    DF_VIDEO_SOURCE_PARAMS vSrcParams;
+
+    LXVideoOffsets(pPriv, id, &vSrcParams);
+
+    pPriv->flipY = vSrcParams.y_offset;
+    pPriv->flipU = vSrcParams.u_offset;
+    pPriv->flipV = vSrcParams.v_offset;
+    pPriv->flipPending = TRUE;
+
+    if (!LXCommitFlip(pPriv, FALSE))
+        pPriv->flipTimer = TimerSet(pPriv->flipTimer, 0, 1, LXFlipTimer,
+                                    pScrni);
+}
+
 static void
 LXDisplayVideo(ScrnInfoPtr pScrni, int id, short width, short height,
                BoxPtr dstBox, short srcW, short srcH, short drawW, short drawH)
 {
+    GeodePortPrivRec *pPriv = GET_PORT_PRIVATE(pScrni);
     long ystart, xend, yend;
     unsigned long lines = 0;
-    unsigned long yExtra, uvExtra = 0;
     DF_VIDEO_POSITION vidPos;
     DF_VIDEO_SOURCE_PARAMS vSrcParams;
     int err;
 
     memset(&vSrcParams, 0, sizeof(vSrcParams));
 
-    gp_wait_until_idle();
+    /* Wait for the frame to be uploaded, if the GP is uploading it */
+    LXWaitVideoBuffer(pPriv);
 
     switch (id) {
     case FOURCC_UYVY:
@@ -370,6 +604,8 @@ LXDisplayVideo(ScrnInfoPtr pScrni, int id, short width, short height,
     case FOURCC_Y800:
     case FOURCC_YV12:
     case FOURCC_I420:
+    case FOURCC_NV12:
+    case FOURCC_NV21:
         vSrcParams.video_format = DF_VIDFMT_Y0Y1Y2Y3;
         break;
     case FOURCC_YUY2:
@@ -421,8 +657,8 @@ LXDisplayVideo(ScrnInfoPtr pScrni, int id, short width, short height,
         lines = 0;
     }
 
-    yExtra = lines * videoScratch.dstPitch;
-    uvExtra = (lines >> 1) * videoScratch.UVPitch;
+    pPriv->yExtra = lines * videoScratch.dstPitch;
+    pPriv->uvExtra = (lines >> 1) * videoScratch.UVPitch;
 
     memset(&vidPos, 0, sizeof(vidPos));
 
@@ -433,23 +669,7 @@ LXDisplayVideo(ScrnInfoPtr pScrni, int id, short width, short height,
 
     df_set_video_position(&vidPos);
 
-    vSrcParams.y_offset = videoScratch.dstOffset + yExtra;
-
-    switch (id) {
-    case FOURCC_Y800:
-    case FOURCC_I420:
-        vSrcParams.u_offset = videoScratch.UDstOffset + uvExtra;
-        vSrcParams.v_offset = videoScratch.VDstOffset + uvExtra;
-        break;
-    case FOURCC_YV12:
-        vSrcParams.v_offset = videoScratch.UDstOffset + uvExtra;
-        vSrcParams.u_offset = videoScratch.VDstOffset + uvExtra;
-        break;
-
-    default:
-        vSrcParams.u_offset = vSrcParams.v_offset = 0;
-        break;
-    }
+    LXVideoOffsets(pPriv, id, &vSrcParams);
 
     vSrcParams.flags = DF_SOURCEFLAG_IMPLICITSCALING;
     df_configure_video_source(&vSrcParams, &vSrcParams);
@@ -504,7 +724,8 @@ LXPutImage(ScrnInfoPtr pScrni,
     dstBox.y1 -= pScrni->frameY0;
     dstBox.y2 -= pScrni->frameY0;
 
-    if (id == FOURCC_YV12 || id == FOURCC_I420)
+    if (id == FOURCC_YV12 || id == FOURCC_I420 ||
+        id == FOURCC_NV12 || id == FOURCC_NV21)
         ret = LXCopyPlanar(pScrni, id, buf, x1, y1, x2, y2, width,
                            height, data);
     else
@@ -526,7 +747,12 @@ LXPutImage(ScrnInfoPtr pScrni,
                        srcW, srcH, drawW, drawH);
         pPriv->pwidth = drawW;
         pPriv->pheight = drawH;
+
+        pPriv->flipBuf = pPriv->curBuf;
+        pPriv->flipPending = FALSE;
     }
+    else if (pPriv->numBufs > 1)
+        LXFlipVideo(pScrni, pPriv, id);
 
     pPriv->videoStatus = CLIENT_VIDEO_ON;
 
@@ -600,6 +826,9 @@ LXStopVideo(ScrnInfoPtr pScrni, pointer data, Bool exit)
     REGION_EMPTY(pScrni->pScreen, &pPriv->clip);
     gp_wait_until_idle();
 
+    TimerCancel(pPriv->flipTimer);
+    pPriv->flipPending = FALSE;
+
     if (exit) {
         if (pPriv->videoStatus & CLIENT_VIDEO_ON) {
             unsigned int val;
@@ -611,10 +840,16 @@ LXStopVideo(ScrnInfoPtr pScrni, pointer data, Bool exit)
         }
 
         if (pPriv->vidmem) {
-            exaOffscreenFree(pScrni->pScreen, pPriv->vidmem);
+            LXFreeVideoMem(pScrni, pPriv->vidmem);
             pPriv->vidmem = NULL;
+
+            /* Take back what the video may have pushed out */
+            LXUpdateOffscreen(pScrni);
         }
 
+        TimerFree(pPriv->flipTimer);
+        pPriv->flipTimer = NULL;
+
         pPriv->videoStatus = 0;
 
         /* Eh? */
@@ -674,8 +909,9 @@ LXVidBlockHandler(BLOCKHANDLER_ARGS_DECL)
             if (pPriv->freeTime < now) {
 
                 if (pPriv->vidmem) {
-                    exaOffscreenFree(pScrni->pScreen, pPriv->vidmem);
+                    LXFreeVideoMem(pScrni, pPriv->vidmem);
                     pPriv->vidmem = NULL;
+                    LXUpdateOffscreen(pScrni);
                 }
 
                 pPriv->videoStatus = 0;
@@ -730,6 +966,10 @@ LXSetupImageVideo(ScreenPtr pScrn)
     adapt->QueryImageAttributes = GeodeQueryImageAttributes;
 
     pPriv->vidmem = NULL;
+    pPriv->bufSize = 0;
+    pPriv->numBufs = 0;
+    pPriv->flipPending = FALSE;
+    pPriv->flipTimer = NULL;
     pPriv->filter = 0;
     pPriv->colorKey = 0;
     pPriv->colorKeyMode = 0;
@@ -756,7 +996,7 @@ LXSetupImageVideo(ScreenPtr pScrn)
 /* Offscreen surface allocation */
 
 struct OffscreenPrivRec {
-    ExaOffscreenArea *vidmem;
+    GeodeMemPtr vidmem;
     Bool isOn;
 };
 
@@ -815,7 +1055,7 @@ LXAllocateSurface(ScrnInfoPtr pScrni, int id, unsigned short w,
 {
     GeodeRec *pGeode = GEODEPTR(pScrni);
     int pitch, lines;
-    ExaOffscreenArea *vidmem;
+    GeodeMemPtr vidmem;
     struct OffscreenPrivRec *pPriv;
 
     if (w > 1024 || h > 1024)
@@ -829,7 +1069,7 @@ LXAllocateSurface(ScrnInfoPtr pScrni, int id, unsigned short w,
 
     /* FIXME: is lines the right parameter to use here,
      * or should it be height * pitch? */
-    vidmem = exaOffscreenAlloc(pScrni->pScreen, lines, 4, TRUE, NULL, NULL);
+    vidmem = LXAllocVideoMem(pScrni, lines, 4, GEODE_MEM_VIDEO);
 
     if (vidmem == NULL) {
         ErrorF("Error while allocating an offscreen region.\n");
@@ -867,7 +1107,7 @@ LXAllocateSurface(ScrnInfoPtr pScrni, int id, unsigned short w,
         free(surface->pitches);
 
     if (vidmem) {
-        exaOffscreenFree(pScrni->pScreen, vidmem);
+        LXFreeVideoMem(pScrni, vidmem);
         vidmem = NULL;
     }
 
@@ -895,8 +1135,9 @@ LXFreeSurface(XF86SurfacePtr surface)
         LXStopSurface(surface);
 
     if (pPriv->vidmem) {
-        exaOffscreenFree(pScrni->pScreen, pPriv->vidmem);
+        LXFreeVideoMem(pScrni, pPriv->vidmem);
         pPriv->vidmem = NULL;
+        LXUpdateOffscreen(pScrni);
     }
 
     free(surface->pitches);